@@ -0,0 +1,162 @@
+/* -------------------------------------------------------------------------- */
+/* sharded_singleton.hpp                                                      */
+/* -------------------------------------------------------------------------- */
+
+#ifndef __DP_SHARDED_SINGLETON_HPP__
+#define __DP_SHARDED_SINGLETON_HPP__
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <algorithm>            // std::max
+#include <atomic>               // std::atomic
+#include <cstddef>              // size_t
+#include <thread>               // std::thread::hardware_concurrency
+#include <utility>              // std::move
+#include <vector>               // std::vector
+
+/* -------------------------------------------------------------------------- */
+/* sharded singleton                                                          */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Wrapper class of a single, sharded instance: one C per hardware
+ * thread, each on it's own cache lines. A thread is given a shard on it's
+ * first GetLocal call, round-robin, and keeps it, so writers on different
+ * cores do not share cache lines. Readers combine the shards with Visit or
+ * Aggregate.
+ * @tparam C Shard class. Requires a constructor with no arguments. Threads
+ * beyond the number of shards share them, and readers run alongside the
+ * writers, so C must be safe to use from multiple threads - such as a set
+ * of relaxed atomic counters.
+ */
+template<class C>
+class ShardedSingleton
+{
+public:
+    static const size_t CACHE_LINE = 64;
+
+    /**
+     * @brief Destroy the Sharded Singleton object and it's shards.
+     */
+    ~ShardedSingleton()                                         = default;
+
+    // non-copyable
+    ShardedSingleton(const ShardedSingleton& other_)            = delete;
+    ShardedSingleton& operator=(const ShardedSingleton& other_) = delete;
+
+    /**
+     * @brief Get the calling thread's shard. After the first call in a
+     * thread, this is a single thread local load.
+     * @return C& Shard of the calling thread.
+     */
+    static inline C& GetLocal();
+
+    /**
+     * @brief Call visit_ with every shard, in order.
+     * @param visit_ Callable object, called with C&.
+     */
+    template<class F>
+    static void Visit(F &&visit_);
+
+    /**
+     * @brief Combine all the shards into a single value.
+     * @param init_ Initial value.
+     * @param reduce_ Callable object, called as reduce_(T, const C&) for
+     * every shard.
+     * @return T The combined value.
+     */
+    template<class T, class Reduce>
+    static T Aggregate(T init_, Reduce &&reduce_);
+
+    /**
+     * @brief Return the number of shards, the number of hardware threads.
+     */
+    static size_t GetNumOfShards();
+
+private:
+    /**
+     * @brief Shard padded to whole cache lines of it's own.
+     */
+    struct alignas(CACHE_LINE) Shard
+    {
+        C m_data;
+    };
+
+    /**
+     * @brief Construct a new Sharded Singleton object.
+     */
+    explicit ShardedSingleton();
+
+    /**
+     * @brief Return the single instance, constructed on first use.
+     */
+    static ShardedSingleton& GetInstance();
+
+    /* members -------------------------------------------------------------- */
+    std::vector<Shard>  m_shards;       // Shard per hardware thread.
+    std::atomic<size_t> m_next;         // Shard of the next new thread.
+};
+
+/* implementation ----------------------------------------------------------- */
+
+template<class C>
+ShardedSingleton<C>::ShardedSingleton():
+    m_shards(std::max(std::thread::hardware_concurrency(), 1U)),
+    m_next(0)
+{
+    // Do nothing
+}
+
+template<class C>
+inline C& ShardedSingleton<C>::GetLocal()
+{
+    // Constant initialized, no guard check.
+    thread_local C *s_local = nullptr;
+
+    if (!s_local)
+    {
+        ShardedSingleton &instance = GetInstance();
+        size_t index = instance.m_next.fetch_add(1, std::memory_order_relaxed);
+
+        s_local = &instance.m_shards[index % instance.m_shards.size()].m_data;
+    }
+
+    return *s_local;
+}
+
+template<class C>
+template<class F>
+void ShardedSingleton<C>::Visit(F &&visit_)
+{
+    for (Shard &shard : GetInstance().m_shards) visit_(shard.m_data);
+}
+
+template<class C>
+template<class T, class Reduce>
+T ShardedSingleton<C>::Aggregate(T init_, Reduce &&reduce_)
+{
+    for (const Shard &shard : GetInstance().m_shards)
+    {
+        init_ = reduce_(std::move(init_), shard.m_data);
+    }
+
+    return init_;
+}
+
+template<class C>
+size_t ShardedSingleton<C>::GetNumOfShards()
+{
+    return GetInstance().m_shards.size();
+}
+
+template<class C>
+ShardedSingleton<C>& ShardedSingleton<C>::GetInstance()
+{
+    static ShardedSingleton<C> s_instance;
+    return s_instance;
+}
+
+/* -------------------------------------------------------------------------- */
+#endif /* __DP_SHARDED_SINGLETON_HPP__ */
@@ -0,0 +1,92 @@
+/* -------------------------------------------------------------------------- */
+/* sharded_singleton_test.cpp                                                 */
+/* -------------------------------------------------------------------------- */
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "sharded_singleton.hpp"
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Shard of a counter, written with relaxed atomics.
+ */
+struct Counter
+{
+    std::atomic<size_t> m_count{0};
+};
+
+typedef ShardedSingleton<Counter> Counters;
+
+/* -------------------------------------------------------------------------- */
+
+static void TestLocal()
+{
+    // A thread keeps the shard it was given.
+    Counter *local = &Counters::GetLocal();
+    assert(local == &Counters::GetLocal());
+
+    // Every shard starts a cache line of it's own.
+    std::vector<uintptr_t> addresses;
+    Counters::Visit([&](Counter &shard_)
+    {
+        addresses.push_back(reinterpret_cast<uintptr_t>(&shard_));
+    });
+
+    assert(Counters::GetNumOfShards() == addresses.size());
+    for (size_t i = 0; i < addresses.size(); ++i)
+    {
+        assert(0 == addresses[i] % Counters::CACHE_LINE);
+        if (0 < i)
+        {
+            assert(addresses[i] - addresses[i - 1] >= Counters::CACHE_LINE);
+        }
+    }
+}
+
+static void TestAggregate()
+{
+    const size_t writers = 4;
+    const size_t adds = 10000;
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < writers; ++i)
+    {
+        threads.emplace_back([]()
+        {
+            Counter &local = Counters::GetLocal();
+            for (size_t j = 0; j < adds; ++j)
+            {
+                local.m_count.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+    for (std::thread &thread : threads) thread.join();
+
+    size_t total = Counters::Aggregate(size_t(0),
+        [](size_t sum_, const Counter &shard_)
+        {
+            return sum_ + shard_.m_count.load(std::memory_order_relaxed);
+        });
+    assert(writers * adds == total);
+}
+
+/* -------------------------------------------------------------------------- */
+
+int main()
+{
+    TestLocal();
+    TestAggregate();
+
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
@@ -5,6 +5,37 @@
 #ifndef __DP_SINGLETON_HPP__
 #define __DP_SINGLETON_HPP__
 
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <cstdlib>              // std::atexit
+#include <mutex>                // std::mutex, std::once_flag, std::call_once
+#include <new>                  // placement new
+#include <utility>              // std::forward
+
+/* -------------------------------------------------------------------------- */
+/* policies                                                                   */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Construction policies of Singleton:
+ *  LazyPolicy          - Default constructed on first use. The default.
+ *  LazyArgsPolicy      - Constructed on first use, from the arguments of the
+ *                        first GetInstance call.
+ *  EagerPolicy         - Default constructed during static initialization,
+ *                        before main.
+ *  ThreadLocalPolicy   - Default constructed on first use in every thread,
+ *                        one instance per thread.
+ *  ExplicitPolicy      - Constructed by Init, before any use. GetInstance has
+ *                        no guard check, for hot paths.
+ */
+struct LazyPolicy {};
+struct LazyArgsPolicy {};
+struct EagerPolicy {};
+struct ThreadLocalPolicy {};
+struct ExplicitPolicy {};
+
 /* -------------------------------------------------------------------------- */
 /* singleton                                                                  */
 /* -------------------------------------------------------------------------- */
@@ -12,10 +43,13 @@
 /**
  * @brief Wrapper class allowing only a single instance to exist at a time.
  * @tparam C Instance class. Singleton requires a constructor with no
- * arguments. In addition, it is recommended to have C non-copyable and with
- * access to the constructor blocked for everyone exept Singleton.
+ * arguments, unless constructed with arguments by the policy. In addition,
+ * it is recommended to have C non-copyable and with access to the
+ * constructor blocked for everyone exept Singleton
+ * (template<class, class> friend class Singleton).
+ * @tparam Policy Construction policy, see above. LazyPolicy by default.
  */
-template<class C>
+template<class C, class Policy = LazyPolicy>
 class Singleton
 {
 public:
@@ -45,14 +79,245 @@ private:
 
 };
 
+/**
+ * @brief Singleton constructed on first use, from the arguments of the
+ * first GetInstance call. Every call goes through a std::call_once check.
+ * The instance is destroyed at exit.
+ */
+template<class C>
+class Singleton<C, LazyArgsPolicy>
+{
+public:
+    ~Singleton()                                    = default;
+
+    // non-copyable
+    Singleton(const Singleton& other_)              = delete;
+    Singleton& operator=(const Singleton& other_)   = delete;
+
+    /**
+     * @brief Get the Instance object, constructing it on the first call.
+     * @param args_ Arguments to construct C with. Ignored after the first
+     * call.
+     * @return C& The single instance of class C.
+     */
+    template<class... Args>
+    static inline C& GetInstance(Args&&... args_);
+
+private:
+    template<class... Args>
+    explicit Singleton(Args&&... args_): m_data(std::forward<Args>(args_)...)
+    {}
+
+    static void Destroy();
+
+    /* members -------------------------------------------------------------- */
+    C m_data;
+
+    static inline std::once_flag    s_once;             // Construction flag.
+    static inline Singleton        *s_instance = nullptr;
+};
+
+/**
+ * @brief Singleton constructed during static initialization, before main.
+ * GetInstance has no guard check. It must not be called from the static
+ * initialization of another translation unit, the order across them is
+ * not defined - use ExplicitPolicy to choose the order.
+ */
+template<class C>
+class Singleton<C, EagerPolicy>
+{
+public:
+    ~Singleton()                                    = default;
+
+    // non-copyable
+    Singleton(const Singleton& other_)              = delete;
+    Singleton& operator=(const Singleton& other_)   = delete;
+
+    /**
+     * @brief Get the Instance object.
+     * @return C& The single instance of class C.
+     */
+    static inline C& GetInstance();
+
+private:
+    explicit Singleton()                            = default;
+
+    /* members -------------------------------------------------------------- */
+    C m_data;
+
+    static Singleton s_instance;
+};
+
+/**
+ * @brief Singleton with an instance per thread, constructed on it's first
+ * use in the thread and destroyed when the thread exits.
+ */
+template<class C>
+class Singleton<C, ThreadLocalPolicy>
+{
+public:
+    ~Singleton()                                    = default;
+
+    // non-copyable
+    Singleton(const Singleton& other_)              = delete;
+    Singleton& operator=(const Singleton& other_)   = delete;
+
+    /**
+     * @brief Get the Instance object of the calling thread.
+     * @return C& The single instance of class C in this thread.
+     */
+    static inline C& GetInstance();
+
+private:
+    explicit Singleton()                            = default;
+
+    /* members -------------------------------------------------------------- */
+    C m_data;
+};
+
+/**
+ * @brief Singleton constructed by an explicit Init call, which must happen
+ * before any GetInstance, for example at the start of main before threads
+ * are created. GetInstance is a single pointer load, with no guard check.
+ */
+template<class C>
+class Singleton<C, ExplicitPolicy>
+{
+public:
+    ~Singleton()                                    = default;
+
+    // non-copyable
+    Singleton(const Singleton& other_)              = delete;
+    Singleton& operator=(const Singleton& other_)   = delete;
+
+    /**
+     * @brief Construct the instance.
+     * @param args_ Arguments to construct C with.
+     * @return bool False if the instance exists already.
+     */
+    template<class... Args>
+    static bool Init(Args&&... args_);
+
+    /**
+     * @brief Destroy the instance. No GetInstance may run meanwhile or after,
+     * until Init is called again.
+     */
+    static void Destroy();
+
+    /**
+     * @brief Get the Instance object. Init must have been called.
+     * @return C& The single instance of class C.
+     */
+    static inline C& GetInstance() noexcept;
+
+    /**
+     * @brief Check if the instance exists.
+     */
+    static bool IsInit() noexcept;
+
+private:
+    template<class... Args>
+    explicit Singleton(Args&&... args_): m_data(std::forward<Args>(args_)...)
+    {}
+
+    /* members -------------------------------------------------------------- */
+    C m_data;
+
+    static inline std::mutex        s_lock;             // Lock for Init.
+    static inline Singleton        *s_instance = nullptr;
+};
+
 /* implementation ----------------------------------------------------------- */
 
+template<class C, class Policy>
+inline C& Singleton<C, Policy>::GetInstance()
+{
+    static Singleton<C, Policy> s_instance;
+    return s_instance.m_data;
+}
+
+/* -------------------------------------------------------------------------- */
+
+template<class C>
+template<class... Args>
+inline C& Singleton<C, LazyArgsPolicy>::GetInstance(Args&&... args_)
+{
+    std::call_once(s_once, [&]()
+    {
+        alignas(Singleton) static unsigned char s_storage[sizeof(Singleton)];
+
+        s_instance = new (s_storage) Singleton(std::forward<Args>(args_)...);
+        std::atexit(&Destroy);
+    });
+
+    return s_instance->m_data;
+}
+
+template<class C>
+void Singleton<C, LazyArgsPolicy>::Destroy()
+{
+    s_instance->~Singleton();
+}
+
+/* -------------------------------------------------------------------------- */
+
+template<class C>
+Singleton<C, EagerPolicy> Singleton<C, EagerPolicy>::s_instance;
+
+template<class C>
+inline C& Singleton<C, EagerPolicy>::GetInstance()
+{
+    return s_instance.m_data;
+}
+
+/* -------------------------------------------------------------------------- */
+
 template<class C>
-inline C& Singleton<C>::GetInstance()
+inline C& Singleton<C, ThreadLocalPolicy>::GetInstance()
 {
-    static Singleton<C> s_instance;
+    thread_local Singleton<C, ThreadLocalPolicy> s_instance;
     return s_instance.m_data;
 }
 
 /* -------------------------------------------------------------------------- */
-#endif /* __DP_SINGLETON_HPP__ */
\ No newline at end of file
+
+template<class C>
+template<class... Args>
+bool Singleton<C, ExplicitPolicy>::Init(Args&&... args_)
+{
+    std::unique_lock<std::mutex> guard(s_lock); // Critical section start.
+
+    if (s_instance) return false;
+
+    alignas(Singleton) static unsigned char s_storage[sizeof(Singleton)];
+
+    s_instance = new (s_storage) Singleton(std::forward<Args>(args_)...);
+
+    return true;
+}                                               // Critical section end.
+
+template<class C>
+void Singleton<C, ExplicitPolicy>::Destroy()
+{
+    std::unique_lock<std::mutex> guard(s_lock); // Critical section start.
+
+    if (!s_instance) return;
+
+    s_instance->~Singleton();
+    s_instance = nullptr;
+}                                               // Critical section end.
+
+template<class C>
+inline C& Singleton<C, ExplicitPolicy>::GetInstance() noexcept
+{
+    return s_instance->m_data;
+}
+
+template<class C>
+bool Singleton<C, ExplicitPolicy>::IsInit() noexcept
+{
+    return (nullptr != s_instance);
+}
+
+/* -------------------------------------------------------------------------- */
+#endif /* __DP_SINGLETON_HPP__ */
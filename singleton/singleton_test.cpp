@@ -0,0 +1,114 @@
+/* -------------------------------------------------------------------------- */
+/* singleton_test.cpp                                                         */
+/* -------------------------------------------------------------------------- */
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <cassert>
+#include <thread>
+
+#include "singleton.hpp"
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Instance class holding the value it was constructed with.
+ */
+template<int Tag>
+struct Value
+{
+    explicit Value(int value_ = 0): m_value(value_) {}
+
+    int m_value;
+};
+
+/* -------------------------------------------------------------------------- */
+
+static void TestLazy()
+{
+    Value<0> &first = Singleton<Value<0>>::GetInstance();
+    first.m_value = 1;
+
+    assert(&first == &Singleton<Value<0>>::GetInstance());
+    assert(1 == Singleton<Value<0>>::GetInstance().m_value);
+
+    typedef Singleton<Value<1>, EagerPolicy> Eager;
+
+    Value<1> &eager = Eager::GetInstance();
+    assert(&eager == &Eager::GetInstance());
+}
+
+static void TestLazyArgs()
+{
+    typedef Singleton<Value<2>, LazyArgsPolicy> Args;
+
+    // The arguments of the later calls are ignored.
+    Value<2> &first = Args::GetInstance(5);
+    assert(5 == first.m_value);
+    assert(&first == &Args::GetInstance(7));
+    assert(5 == Args::GetInstance().m_value);
+}
+
+static void TestThreadLocal()
+{
+    typedef Singleton<Value<3>, ThreadLocalPolicy> Local;
+
+    Value<3> *main_instance = &Local::GetInstance();
+    Value<3> *other_instance = nullptr;
+    bool is_same = false;
+
+    // Stable within a thread, separate across threads.
+    std::thread other([&]()
+    {
+        other_instance = &Local::GetInstance();
+        is_same = (other_instance == &Local::GetInstance());
+    });
+    other.join();
+
+    assert(is_same);
+    assert(main_instance == &Local::GetInstance());
+    assert(main_instance != other_instance);
+}
+
+static void TestExplicit()
+{
+    typedef Singleton<Value<4>, ExplicitPolicy> Explicit;
+
+    assert(!Explicit::IsInit());
+
+    bool is_ok = Explicit::Init(3);
+    assert(is_ok);
+    assert(Explicit::IsInit());
+    assert(3 == Explicit::GetInstance().m_value);
+
+    is_ok = Explicit::Init(4);
+    assert(!is_ok);
+    assert(3 == Explicit::GetInstance().m_value);
+
+    // Destroyed, then constructed again with new arguments.
+    Explicit::Destroy();
+    assert(!Explicit::IsInit());
+    Explicit::Destroy();
+
+    is_ok = Explicit::Init(6);
+    assert(is_ok);
+    assert(6 == Explicit::GetInstance().m_value);
+
+    Explicit::Destroy();
+}
+
+/* -------------------------------------------------------------------------- */
+
+int main()
+{
+    TestLazy();
+    TestLazyArgs();
+    TestThreadLocal();
+    TestExplicit();
+
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
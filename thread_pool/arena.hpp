@@ -0,0 +1,475 @@
+/* -------------------------------------------------------------------------- */
+/* arena.hpp                                                                  */
+/* -------------------------------------------------------------------------- */
+
+#ifndef __DP_ARENA_HPP__
+#define __DP_ARENA_HPP__
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <atomic>               // std::atomic
+#include <cstddef>              // size_t, std::max_align_t
+#include <cstdint>              // uintptr_t
+#include <new>                  // operator new, std::bad_alloc
+#include <type_traits>          // std::is_trivially_destructible
+#include <utility>              // std::forward
+
+/* -------------------------------------------------------------------------- */
+/* arena                                                                      */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Bump allocator for scratch memory that lives as long as a single
+ * Task. Every ThreadPool thread owns one, current for it's thread, and the
+ * pool resets it after every Callable. Memory is taken from blocks of
+ * BLOCK_SIZE bytes, kept for reuse after Reset, so a thread allocates from
+ * the heap only while it's Callables need more than ever before.
+ * Not thread safe, and never runs destructors.
+ */
+class alignas(64) Arena
+{
+public:
+    static const size_t BLOCK_SIZE = 64 * 1024;
+
+    /**
+     * @brief Construct an empty Arena object. No block is allocated yet.
+     */
+    Arena() noexcept;
+
+    /**
+     * @brief Destroy the Arena object and free it's blocks.
+     */
+    ~Arena();
+
+    // non-copyable
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+     * @brief Allocate memory, valid until the next Reset.
+     * @param size_ Number of bytes.
+     * @param align_ Alignment, a power of 2.
+     * @return void* Allocated memory. Throws std::bad_alloc on failure.
+     */
+    void *Allocate(size_t size_, size_t align_ = alignof(std::max_align_t));
+
+    /**
+     * @brief Construct a T in the arena. It is never destroyed, so T must be
+     * trivially destructible.
+     * @param args_ Arguments to construct T with.
+     * @return T* The new object, valid until the next Reset.
+     */
+    template<class T, class... Args>
+    T *New(Args&&... args_);
+
+    /**
+     * @brief Free all the memory allocated, keeping the blocks for reuse.
+     */
+    void Reset() noexcept;
+
+    /**
+     * @brief Return the number of bytes in the arena's blocks.
+     */
+    size_t GetCapacity() const noexcept;
+
+    /**
+     * @brief Return the arena of the calling ThreadPool thread.
+     * @return Arena* nullptr outside of a ThreadPool's Callable.
+     */
+    static Arena *Current() noexcept;
+
+    /**
+     * @brief Set the arena returned by Current() on the calling thread.
+     */
+    static void SetCurrent(Arena *arena_) noexcept;
+
+private:
+    /**
+     * @brief Header of a block, it's memory follows.
+     */
+    struct Block
+    {
+        Block          *m_next;         // Next block, used after this one.
+        size_t          m_size;         // Bytes following the header.
+    };
+
+    /**
+     * @brief Move to the next block able to hold size_ bytes aligned to
+     * align_, allocating one if needed.
+     */
+    void Grow(size_t size_, size_t align_);
+
+    static unsigned char *Begin(Block *block_) noexcept;
+
+    /* members -------------------------------------------------------------- */
+    unsigned char  *m_cursor;           // Next free byte.
+    unsigned char  *m_end;              // End of the current block.
+    Block          *m_head;             // First block.
+    Block          *m_block;            // Current block.
+
+    static thread_local Arena *s_current;
+};
+
+/**
+ * @brief Standard allocator over an Arena, for task-scoped containers.
+ * Deallocation does nothing, the memory is freed by the arena's Reset.
+ * @tparam T Type to allocate.
+ */
+template<class T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(Arena &arena_) noexcept: m_arena(&arena_) {}
+
+    template<class U>
+    ArenaAllocator(const ArenaAllocator<U> &other_) noexcept:
+        m_arena(other_.GetArena())
+    {}
+
+    T *allocate(size_t n_)
+    {
+        return static_cast<T *>(m_arena->Allocate(n_ * sizeof(T),
+                                                  alignof(T)));
+    }
+
+    void deallocate(T *, size_t) noexcept {}
+
+    Arena *GetArena() const noexcept { return m_arena; }
+
+    template<class U>
+    bool operator==(const ArenaAllocator<U> &other_) const noexcept
+    {
+        return (m_arena == other_.GetArena());
+    }
+
+    template<class U>
+    bool operator!=(const ArenaAllocator<U> &other_) const noexcept
+    {
+        return (m_arena != other_.GetArena());
+    }
+
+private:
+    Arena  *m_arena;    // Arena to allocate from.
+};
+
+/* -------------------------------------------------------------------------- */
+/* node pool                                                                  */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Thread local free lists of small nodes in CLASSES size classes,
+ * used by Task for callables that do not fit inline. A node freed by any
+ * thread is kept by that thread, and reused by it's next allocation of the
+ * class, without going through malloc. Past CACHE_MAX nodes in a class, a
+ * batch of them moves to a lock-free stack shared by all threads, which a
+ * thread with an empty list takes whole: so nodes allocated by a pushing
+ * thread and freed by the pool's threads flow back to the pushing thread.
+ * Larger sizes go to operator new directly.
+ */
+class NodePool
+{
+public:
+    static const size_t CLASSES = 4;            // 64, 128, 256, 512 bytes.
+    static const size_t MIN_SIZE = 64;          // Size of the first class.
+    static const size_t CACHE_MAX = 256;        // Nodes kept per class.
+
+    /**
+     * @brief Allocate a node. Aligned to alignof(std::max_align_t).
+     * @param size_ Number of bytes.
+     */
+    static void *Allocate(size_t size_);
+
+    /**
+     * @brief Free a node allocated with the same size_.
+     */
+    static void Deallocate(void *node_, size_t size_) noexcept;
+
+private:
+    /**
+     * @brief Free node, linked in it's class list.
+     */
+    struct Node
+    {
+        Node   *m_next;
+    };
+
+    /**
+     * @brief Class list of a thread.
+     */
+    struct FreeList
+    {
+        Node   *m_head;
+        size_t  m_count;
+    };
+
+    /**
+     * @brief Frees the nodes kept by a thread when it exits.
+     */
+    struct Flusher
+    {
+        ~Flusher();
+        void Touch() noexcept {}
+    };
+
+    /**
+     * @brief Return the class of size_, CLASSES if too large.
+     */
+    static size_t ClassOf(size_t size_) noexcept;
+
+    /**
+     * @brief Move count_ nodes from the head of list_ to the shared stack of
+     * class index_. Pushing never takes a node out, so there is no ABA.
+     */
+    static void Share(FreeList &list_, size_t index_, size_t count_) noexcept;
+
+    /**
+     * @brief Refill an empty list_ with the whole shared stack of class
+     * index_. Return false if the stack was empty.
+     */
+    static bool Take(FreeList &list_, size_t index_) noexcept;
+
+    static std::atomic<Node *>      s_shared[CLASSES];
+    static thread_local FreeList    s_lists[CLASSES];
+    static thread_local bool        s_is_closed;
+    static thread_local Flusher     s_flusher;
+};
+
+/* implementation ----------------------------------------------------------- */
+
+inline thread_local Arena *Arena::s_current = nullptr;
+
+inline Arena::Arena() noexcept:
+    m_cursor(nullptr),
+    m_end(nullptr),
+    m_head(nullptr),
+    m_block(nullptr)
+{
+    // Do nothing
+}
+
+inline Arena::~Arena()
+{
+    while (m_head)
+    {
+        Block *next = m_head->m_next;
+        ::operator delete(m_head);
+        m_head = next;
+    }
+}
+
+inline void *Arena::Allocate(size_t size_, size_t align_)
+{
+    uintptr_t cursor = reinterpret_cast<uintptr_t>(m_cursor);
+    uintptr_t aligned = (cursor + align_ - 1) & ~(uintptr_t(align_) - 1);
+
+    if (!m_cursor || aligned + size_ > reinterpret_cast<uintptr_t>(m_end))
+    {
+        Grow(size_, align_);
+
+        cursor = reinterpret_cast<uintptr_t>(m_cursor);
+        aligned = (cursor + align_ - 1) & ~(uintptr_t(align_) - 1);
+    }
+
+    m_cursor = reinterpret_cast<unsigned char *>(aligned) + size_;
+
+    return reinterpret_cast<void *>(aligned);
+}
+
+template<class T, class... Args>
+T *Arena::New(Args&&... args_)
+{
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "Arena never destroys it's objects.");
+
+    return new (Allocate(sizeof(T), alignof(T)))
+               T(std::forward<Args>(args_)...);
+}
+
+inline void Arena::Reset() noexcept
+{
+    if (m_block == m_head)
+    {
+        m_cursor = m_head ? Begin(m_head) : nullptr;
+        return;
+    }
+
+    m_block = m_head;
+    m_cursor = Begin(m_head);
+    m_end = m_cursor + m_head->m_size;
+}
+
+inline size_t Arena::GetCapacity() const noexcept
+{
+    size_t ret = 0;
+
+    for (Block *block = m_head; block; block = block->m_next)
+    {
+        ret += block->m_size;
+    }
+
+    return ret;
+}
+
+inline Arena *Arena::Current() noexcept
+{
+    return s_current;
+}
+
+inline void Arena::SetCurrent(Arena *arena_) noexcept
+{
+    s_current = arena_;
+}
+
+inline void Arena::Grow(size_t size_, size_t align_)
+{
+    // Reuse the next blocks kept by Reset, if large enough.
+    Block *next = m_block ? m_block->m_next : m_head;
+
+    if (!next || next->m_size < size_ + align_)
+    {
+        size_t bytes = (size_ + align_ > BLOCK_SIZE) ? size_ + align_ :
+                                                       BLOCK_SIZE;
+
+        Block *block = static_cast<Block *>(
+            ::operator new(sizeof(Block) + bytes)
+        );
+        block->m_size = bytes;
+        block->m_next = next;
+
+        if (m_block)
+        {
+            m_block->m_next = block;
+        }
+        else
+        {
+            m_head = block;
+        }
+
+        next = block;
+    }
+
+    m_block = next;
+    m_cursor = Begin(next);
+    m_end = m_cursor + next->m_size;
+}
+
+inline unsigned char *Arena::Begin(Block *block_) noexcept
+{
+    return reinterpret_cast<unsigned char *>(block_ + 1);
+}
+
+/* -------------------------------------------------------------------------- */
+
+inline std::atomic<NodePool::Node *> NodePool::s_shared[CLASSES] = {};
+inline thread_local NodePool::FreeList NodePool::s_lists[CLASSES] = {};
+inline thread_local bool NodePool::s_is_closed = false;
+inline thread_local NodePool::Flusher NodePool::s_flusher;
+
+inline void *NodePool::Allocate(size_t size_)
+{
+    size_t index = ClassOf(size_);
+    if (CLASSES == index) return ::operator new(size_);
+
+    // Registers the thread's lists to be freed on exit.
+    s_flusher.Touch();
+
+    FreeList &list = s_lists[index];
+
+    if (!list.m_head && !Take(list, index))
+    {
+        return ::operator new(MIN_SIZE << index);
+    }
+
+    Node *node = list.m_head;
+    list.m_head = node->m_next;
+    --list.m_count;
+
+    return node;
+}
+
+inline void NodePool::Deallocate(void *node_, size_t size_) noexcept
+{
+    size_t index = ClassOf(size_);
+
+    if (CLASSES == index || s_is_closed)
+    {
+        ::operator delete(node_);
+        return;
+    }
+
+    s_flusher.Touch();
+
+    FreeList &list = s_lists[index];
+    Node *node = static_cast<Node *>(node_);
+
+    node->m_next = list.m_head;
+    list.m_head = node;
+    ++list.m_count;
+
+    // A thread that only frees hands the nodes on, half a cache at a time.
+    if (CACHE_MAX < list.m_count) Share(list, index, CACHE_MAX / 2);
+}
+
+inline NodePool::Flusher::~Flusher()
+{
+    // Nodes freed from now on, by other thread locals, go to the heap.
+    s_is_closed = true;
+
+    // Kept for the other threads.
+    for (size_t i = 0; i < CLASSES; ++i)
+    {
+        if (s_lists[i].m_head) Share(s_lists[i], i, s_lists[i].m_count);
+    }
+}
+
+inline size_t NodePool::ClassOf(size_t size_) noexcept
+{
+    size_t index = 0;
+
+    while (index < CLASSES && (MIN_SIZE << index) < size_) ++index;
+
+    return index;
+}
+
+inline void NodePool::Share(FreeList &list_, size_t index_,
+                            size_t count_) noexcept
+{
+    Node *first = list_.m_head;
+    Node *last = first;
+
+    for (size_t i = 1; i < count_; ++i) last = last->m_next;
+
+    list_.m_head = last->m_next;
+    list_.m_count -= count_;
+
+    Node *head = s_shared[index_].load(std::memory_order_relaxed);
+
+    do
+    {
+        last->m_next = head;
+    }
+    while (!s_shared[index_].compare_exchange_weak(
+               head, first, std::memory_order_release,
+               std::memory_order_relaxed));
+}
+
+inline bool NodePool::Take(FreeList &list_, size_t index_) noexcept
+{
+    // Taken whole, so no other thread pops a node from under this one.
+    Node *head = s_shared[index_].exchange(nullptr, std::memory_order_acquire);
+    if (!head) return false;
+
+    list_.m_head = head;
+    list_.m_count = 0;
+
+    for (Node *node = head; node; node = node->m_next) ++list_.m_count;
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+#endif /* __DP_ARENA_HPP__ */
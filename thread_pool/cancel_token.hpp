@@ -0,0 +1,175 @@
+/* -------------------------------------------------------------------------- */
+/* cancel_token.hpp                                                           */
+/* -------------------------------------------------------------------------- */
+
+#ifndef __DP_CANCEL_TOKEN_HPP__
+#define __DP_CANCEL_TOKEN_HPP__
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <atomic>               // std::atomic
+#include <cstddef>              // size_t
+#include <utility>              // std::swap
+
+/* -------------------------------------------------------------------------- */
+/* cancel token                                                               */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Read side of a cancellation, given to ThreadPool::Push with the
+ * Callable. A Callable still queued when it's token is cancelled is dropped
+ * by the thread that pops it, instead of being called; a running one polls
+ * CancelToken::Current() and returns early. A default constructed token is
+ * never cancelled. Copies share the state, one pointer wide.
+ */
+class CancelToken
+{
+public:
+    /**
+     * @brief Construct a token that is never cancelled.
+     */
+    CancelToken() noexcept: m_state(nullptr) {}
+
+    CancelToken(const CancelToken &other_) noexcept;
+    CancelToken(CancelToken &&other_) noexcept;
+    CancelToken& operator=(CancelToken other_) noexcept;
+    ~CancelToken();
+
+    /**
+     * @brief Check if the token's source was cancelled. A single load.
+     */
+    bool IsCancelled() const noexcept;
+
+    /**
+     * @brief Return the token of the Callable running on the calling
+     * ThreadPool thread, a token never cancelled outside of one.
+     */
+    static const CancelToken &Current() noexcept;
+
+    /**
+     * @brief Set the token returned by Current() on the calling thread.
+     * @param token_ Token of the Callable to run, nullptr once it returns.
+     */
+    static void SetCurrent(const CancelToken *token_) noexcept;
+
+private:
+    friend class CancelSource;
+
+    /**
+     * @brief State shared by a source and it's tokens.
+     */
+    struct State
+    {
+        std::atomic<bool>   m_is_cancelled{false};
+        std::atomic<size_t> m_refs{1};
+    };
+
+    explicit CancelToken(State *state_) noexcept: m_state(state_) {}
+
+    /* members -------------------------------------------------------------- */
+    State  *m_state;                    // Shared state, nullptr if none.
+
+    static thread_local const CancelToken *s_current;
+};
+
+/**
+ * @brief Write side of a cancellation. Copies cancel the same tokens.
+ */
+class CancelSource
+{
+public:
+    /**
+     * @brief Construct a new Cancel Source object, not cancelled.
+     */
+    CancelSource();
+
+    /**
+     * @brief Return a token cancelled with this source.
+     */
+    CancelToken GetToken() const noexcept { return m_token; }
+
+    /**
+     * @brief Cancel the tokens of this source. Takes effect on the queued
+     * Callables when they are popped, and is never undone.
+     */
+    void Cancel() noexcept;
+
+    /**
+     * @brief Check if Cancel was called.
+     */
+    bool IsCancelled() const noexcept { return m_token.IsCancelled(); }
+
+private:
+    /* members -------------------------------------------------------------- */
+    CancelToken m_token;                // Token holding the shared state.
+};
+
+/* implementation ----------------------------------------------------------- */
+
+inline thread_local const CancelToken *CancelToken::s_current = nullptr;
+
+inline CancelToken::CancelToken(const CancelToken &other_) noexcept:
+    m_state(other_.m_state)
+{
+    if (m_state) m_state->m_refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline CancelToken::CancelToken(CancelToken &&other_) noexcept:
+    m_state(other_.m_state)
+{
+    other_.m_state = nullptr;
+}
+
+inline CancelToken& CancelToken::operator=(CancelToken other_) noexcept
+{
+    std::swap(m_state, other_.m_state);
+
+    return *this;
+}
+
+inline CancelToken::~CancelToken()
+{
+    if (m_state && 1 == m_state->m_refs.fetch_sub(1,
+                                                  std::memory_order_acq_rel))
+    {
+        delete m_state;
+    }
+}
+
+inline bool CancelToken::IsCancelled() const noexcept
+{
+    return (m_state && m_state->m_is_cancelled.load(std::memory_order_acquire));
+}
+
+inline const CancelToken &CancelToken::Current() noexcept
+{
+    static const CancelToken s_none;
+
+    return s_current ? *s_current : s_none;
+}
+
+inline void CancelToken::SetCurrent(const CancelToken *token_) noexcept
+{
+    s_current = token_;
+}
+
+/* -------------------------------------------------------------------------- */
+
+inline CancelSource::CancelSource():
+    m_token(new CancelToken::State())
+{
+    // Do nothing
+}
+
+inline void CancelSource::Cancel() noexcept
+{
+    // Moved from.
+    if (!m_token.m_state) return;
+
+    m_token.m_state->m_is_cancelled.store(true, std::memory_order_release);
+}
+
+/* -------------------------------------------------------------------------- */
+#endif /* __DP_CANCEL_TOKEN_HPP__ */
@@ -0,0 +1,396 @@
+/* -------------------------------------------------------------------------- */
+/* coroutine.hpp                                                              */
+/* -------------------------------------------------------------------------- */
+
+#ifndef __DP_COROUTINE_HPP__
+#define __DP_COROUTINE_HPP__
+
+#if __cplusplus < 202002L
+#error "coroutine.hpp requires C++20."
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <coroutine>            // std::coroutine_handle, std::suspend_always
+#include <exception>            // std::exception_ptr, std::terminate
+#include <future>               // std::promise, std::future_error
+#include <optional>             // std::optional
+#include <type_traits>          // std::is_void
+#include <utility>              // std::move, std::exchange
+
+#include <thread_pool/task.hpp>
+
+/* -------------------------------------------------------------------------- */
+/* schedule                                                                   */
+/* -------------------------------------------------------------------------- */
+
+namespace details
+{
+
+/**
+ * @brief How a Schedule resumed it's coroutine.
+ */
+enum class ResumeState { PENDING, REFUSED, DROPPED };
+
+/**
+ * @brief Callable owning a suspended coroutine, resuming it when called. If
+ * it is destroyed without being called, the coroutine is resumed anyway as
+ * DROPPED, so it's frame is neither leaked nor left waiting - unless the
+ * Push was refused, and the awaiter continues it instead.
+ */
+class Resumer
+{
+public:
+    Resumer(std::coroutine_handle<> handle_, ResumeState *state_) noexcept:
+        m_handle(handle_),
+        m_state(state_)
+    {}
+
+    ~Resumer()
+    {
+        if (!m_handle || ResumeState::REFUSED == *m_state) return;
+
+        *m_state = ResumeState::DROPPED;
+        m_handle.resume();
+    }
+
+    // non-copyable
+    Resumer(const Resumer&) = delete;
+    Resumer& operator=(const Resumer&) = delete;
+
+    // movable
+    Resumer(Resumer &&other_) noexcept:
+        m_handle(std::exchange(other_.m_handle, nullptr)),
+        m_state(other_.m_state)
+    {}
+
+    Resumer& operator=(Resumer &&) = delete;
+
+    void operator()()
+    {
+        std::exchange(m_handle, nullptr).resume();
+    }
+
+private:
+    std::coroutine_handle<> m_handle;   // Suspended coroutine, resumed once.
+    ResumeState            *m_state;    // State of it's awaiter.
+};
+
+} // namespace details
+
+/**
+ * @brief Awaitable that resumes the awaiting coroutine on one of a Thread
+ * Pool's threads. If the pool refuses the Task, the coroutine continues on
+ * the current thread. If the pool drops the Task instead of calling it -
+ * Finish(false), it's destructor, an overflow policy or a cancellation -
+ * the dropping thread resumes the coroutine and the co_await throws
+ * std::future_error with broken_promise, as a Submit result would. A
+ * coroutine dropped by the pool's destructor must not schedule on it again.
+ * @tparam Pool ThreadPool with Task as it's Callable.
+ */
+template<class Pool>
+class ScheduleAwaiter
+{
+public:
+    explicit ScheduleAwaiter(Pool &pool_) noexcept:
+        m_pool(pool_),
+        m_state(details::ResumeState::PENDING)
+    {}
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle_)
+    {
+        Task task(details::Resumer(handle_, &m_state));
+
+        // The coroutine may be resumed, and done, before Push returns.
+        if (m_pool.Push(std::move(task))) return true;
+
+        // Moved in and dropped by the refusing Push, resumed already.
+        if (!task) return true;
+
+        // Not suspended if refused, the Task is destroyed without resuming.
+        m_state = details::ResumeState::REFUSED;
+        return false;
+    }
+
+    void await_resume() const
+    {
+        if (details::ResumeState::DROPPED == m_state)
+        {
+            throw(std::future_error(std::future_errc::broken_promise));
+        }
+    }
+
+private:
+    Pool                   &m_pool;     // Pool to resume on.
+    details::ResumeState    m_state;    // How the coroutine was resumed.
+};
+
+/**
+ * @brief Return an awaitable that moves the coroutine to pool_.
+ * Usage: co_await Schedule(pool);
+ */
+template<class Pool>
+ScheduleAwaiter<Pool> Schedule(Pool &pool_) noexcept
+{
+    return ScheduleAwaiter<Pool>(pool_);
+}
+
+/* -------------------------------------------------------------------------- */
+/* coroutine task                                                             */
+/* -------------------------------------------------------------------------- */
+
+template<class T>
+class CoTask;
+
+namespace details
+{
+
+/**
+ * @brief Promise parts shared by every CoTask: the awaiting coroutine and
+ * the exception thrown, if any.
+ */
+class CoPromiseBase
+{
+public:
+    /**
+     * @brief On completion, resume the awaiting coroutine directly on this
+     * thread, without going through the pool's queue.
+     */
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
+
+        template<class Promise>
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<Promise> handle_) noexcept
+        {
+            std::coroutine_handle<> next = handle_.promise().m_continuation;
+
+            return next ? next : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+
+    void unhandled_exception() noexcept
+    {
+        m_exception = std::current_exception();
+    }
+
+    std::coroutine_handle<>     m_continuation; // Coroutine awaiting result.
+    std::exception_ptr          m_exception;    // Exception thrown, if any.
+};
+
+template<class T>
+class CoPromise: public CoPromiseBase
+{
+public:
+    CoTask<T> get_return_object() noexcept;
+
+    template<class U>
+    void return_value(U &&value_)
+    {
+        m_value.emplace(std::forward<U>(value_));
+    }
+
+    T Get()
+    {
+        if (m_exception) std::rethrow_exception(m_exception);
+
+        return std::move(*m_value);
+    }
+
+    std::optional<T>    m_value;    // Result, once returned.
+};
+
+template<>
+class CoPromise<void>: public CoPromiseBase
+{
+public:
+    CoTask<void> get_return_object() noexcept;
+
+    void return_void() const noexcept {}
+
+    void Get()
+    {
+        if (m_exception) std::rethrow_exception(m_exception);
+    }
+};
+
+/**
+ * @brief Fire and forget coroutine, used to drive SyncWait().
+ */
+struct Detached
+{
+    struct promise_type
+    {
+        Detached get_return_object() const noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept { std::terminate(); }
+    };
+};
+
+} // namespace details
+
+/**
+ * @brief Lazily started coroutine returning T. It starts when awaited, and
+ * on completion resumes it's awaiter directly. Awaiting it returns the
+ * value, or rethrows the exception, of the coroutine.
+ * @tparam T Result type. void for none.
+ */
+template<class T = void>
+class CoTask
+{
+public:
+    typedef details::CoPromise<T> promise_type;
+
+    /**
+     * @brief Awaiting side of a CoTask.
+     */
+    class Awaiter
+    {
+    public:
+        explicit Awaiter(std::coroutine_handle<promise_type> handle_) noexcept:
+            m_handle(handle_)
+        {}
+
+        bool await_ready() const noexcept
+        {
+            return (!m_handle || m_handle.done());
+        }
+
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<> awaiting_) noexcept
+        {
+            m_handle.promise().m_continuation = awaiting_;
+
+            // Start the task on this thread.
+            return m_handle;
+        }
+
+        T await_resume()
+        {
+            return m_handle.promise().Get();
+        }
+
+    private:
+        std::coroutine_handle<promise_type> m_handle;   // Awaited task.
+    };
+
+    /**
+     * @brief Construct an empty CoTask object.
+     */
+    CoTask() noexcept: m_handle() {}
+
+    explicit CoTask(std::coroutine_handle<promise_type> handle_) noexcept:
+        m_handle(handle_)
+    {}
+
+    /**
+     * @brief Destroy the CoTask object and it's coroutine frame.
+     */
+    ~CoTask()
+    {
+        if (m_handle) m_handle.destroy();
+    }
+
+    // non-copyable
+    CoTask(const CoTask&) = delete;
+    CoTask& operator=(const CoTask&) = delete;
+
+    // movable
+    CoTask(CoTask &&other_) noexcept:
+        m_handle(std::exchange(other_.m_handle, nullptr))
+    {}
+
+    CoTask& operator=(CoTask &&other_) noexcept
+    {
+        if (this != &other_)
+        {
+            if (m_handle) m_handle.destroy();
+            m_handle = std::exchange(other_.m_handle, nullptr);
+        }
+
+        return *this;
+    }
+
+    Awaiter operator co_await() const noexcept
+    {
+        return Awaiter(m_handle);
+    }
+
+private:
+    std::coroutine_handle<promise_type> m_handle;   // Coroutine frame.
+};
+
+namespace details
+{
+
+template<class T>
+CoTask<T> CoPromise<T>::get_return_object() noexcept
+{
+    return CoTask<T>(std::coroutine_handle<CoPromise<T>>::from_promise(*this));
+}
+
+inline CoTask<void> CoPromise<void>::get_return_object() noexcept
+{
+    return CoTask<void>(
+        std::coroutine_handle<CoPromise<void>>::from_promise(*this)
+    );
+}
+
+/**
+ * @brief Await task_ and hand it's result to done_. The promise is owned by
+ * the coroutine, so the waiting thread never races with it's destruction.
+ */
+template<class T>
+Detached SyncDrive(CoTask<T> &task_, std::promise<T> done_)
+{
+    try
+    {
+        if constexpr (std::is_void<T>::value)
+        {
+            co_await task_;
+            done_.set_value();
+        }
+        else
+        {
+            done_.set_value(co_await task_);
+        }
+    }
+    catch (...)
+    {
+        done_.set_exception(std::current_exception());
+    }
+}
+
+} // namespace details
+
+/**
+ * @brief Start task_ on the calling thread and block until it is done.
+ * Used to await a coroutine from outside of any coroutine.
+ * @return T Result of task_. It's exception is rethrown.
+ */
+template<class T>
+T SyncWait(CoTask<T> &&task_)
+{
+    CoTask<T> task(std::move(task_));
+    std::promise<T> done;
+    std::future<T> result = done.get_future();
+
+    details::SyncDrive(task, std::move(done));
+
+    return result.get();
+}
+
+/* -------------------------------------------------------------------------- */
+#endif /* __DP_COROUTINE_HPP__ */
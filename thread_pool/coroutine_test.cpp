@@ -0,0 +1,131 @@
+/* -------------------------------------------------------------------------- */
+/* coroutine_test.cpp                                                         */
+/* -------------------------------------------------------------------------- */
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <cassert>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+#include "coroutine.hpp"
+#include "thread_pool.hpp"
+
+/* -------------------------------------------------------------------------- */
+
+typedef ThreadPool<Task> Pool;
+typedef ThreadPool<Task, PriorityQueue<Task>, PoolStats> StatsPool;
+
+template<class P>
+static CoTask<std::thread::id> WorkerId(P &pool_)
+{
+    co_await Schedule(pool_);
+
+    co_return std::this_thread::get_id();
+}
+
+static CoTask<int> Add(Pool &pool_, int lhs_, int rhs_)
+{
+    co_await Schedule(pool_);
+
+    co_return lhs_ + rhs_;
+}
+
+static CoTask<int> Sum(Pool &pool_, int count_)
+{
+    int sum = 0;
+
+    for (int i = 0; i < count_; ++i) sum += co_await Add(pool_, i, 1);
+
+    co_return sum;
+}
+
+static CoTask<> Throw(Pool &pool_)
+{
+    co_await Schedule(pool_);
+
+    throw std::runtime_error("coroutine");
+}
+
+/**
+ * @brief A coroutine queued on a pool destroyed without running it is
+ * resumed with an exception, instead of leaking and hanging it's SyncWait.
+ */
+static void TestDropped()
+{
+    Semaphore started(0);
+    Semaphore release(0);
+    bool is_dropped = false;
+    std::thread waiter;
+
+    {
+        StatsPool pool(1);
+
+        bool is_pushed = pool.Push(Task([&](){
+            started.post();
+            release.wait();
+        }));
+        assert(is_pushed);
+        started.wait();
+
+        // Queued behind the blocked thread.
+        waiter = std::thread([&]()
+        {
+            try
+            {
+                SyncWait(WorkerId(pool));
+            }
+            catch (const std::future_error&)
+            {
+                is_dropped = true;
+            }
+        });
+        while (2 != pool.GetStats().m_pushed) std::this_thread::yield();
+
+        pool.FinishAsync(std::function<void()>(), false);
+        release.post();
+    }
+
+    waiter.join();
+    assert(is_dropped);
+}
+
+/* -------------------------------------------------------------------------- */
+
+int main()
+{
+    Pool pool(2);
+
+    std::thread::id worker = SyncWait(WorkerId(pool));
+    assert(std::this_thread::get_id() != worker);
+
+    int sum = SyncWait(Add(pool, 0, 1));
+    assert(1 == sum);
+    sum = SyncWait(Sum(pool, 1000));
+    assert(1000 * 1001 / 2 == sum);
+
+    bool is_thrown = false;
+    try
+    {
+        SyncWait(Throw(pool));
+    }
+    catch (const std::runtime_error&)
+    {
+        is_thrown = true;
+    }
+    assert(is_thrown);
+
+    TestDropped();
+
+    // A refused Schedule continues on the calling thread.
+    pool.Finish(false);
+    worker = SyncWait(WorkerId(pool));
+    assert(std::this_thread::get_id() == worker);
+
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,339 @@
+/* -------------------------------------------------------------------------- */
+/* executor_group.hpp                                                         */
+/* -------------------------------------------------------------------------- */
+
+#ifndef __DP_EXECUTOR_GROUP_HPP__
+#define __DP_EXECUTOR_GROUP_HPP__
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <algorithm>            // std::max
+#include <cstddef>              // size_t
+#include <cstdint>              // uint64_t
+#include <deque>                // std::deque
+#include <memory>               // std::unique_ptr
+#include <mutex>                // std::mutex, std::unique_lock
+#include <stdexcept>            // std::invalid_argument
+#include <utility>              // std::move
+#include <vector>               // std::vector
+
+#include <thread_pool/task.hpp>
+#include <thread_pool/thread_pool.hpp>
+#include <tools/affinity/affinity.hpp>
+
+/* -------------------------------------------------------------------------- */
+
+template<class Callable>
+class Executor;
+
+/* -------------------------------------------------------------------------- */
+/* executor group                                                             */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Set of threads shared by several logical executors, each with it's
+ * own Callable type and queue, instead of a ThreadPool per Callable type
+ * oversubscribing the CPUs. Every Callable pushed to an executor pushes one
+ * Task to the group's ThreadPool<Task>; the thread running it takes the
+ * Callable of the executor with the least service so far relative to it's
+ * weight (stride scheduling), so under load every executor gets threads in
+ * proportion to it's weight, and an idle executor's share goes to the rest.
+ */
+class ExecutorGroup
+{
+public:
+    typedef ThreadPool<Task> Pool;
+
+    /**
+     * @brief Construct a new Executor Group object, with the ThreadPool
+     * defaults: a thread per CPU, PRIORITY scheduling.
+     */
+    ExecutorGroup();
+
+    /**
+     * @brief Construct a new Executor Group object.
+     * @param threads_num_ Number of threads shared by the executors.
+     * @param scheduling_ Scheduling mode of the shared Thread Pool.
+     * @param affinity_ Placement of the threads on CPUs, by their slot.
+     */
+    explicit ExecutorGroup(size_t threads_num_,
+                           Pool::Scheduling scheduling_ = Pool::PRIORITY,
+                           const Affinity &affinity_ = Affinity());
+
+    /**
+     * @brief Destroy the Executor Group object. Stops the threads, the
+     * Callables still queued in it's executors are not called.
+     */
+    ~ExecutorGroup() = default;
+
+    // non-copyable
+    ExecutorGroup(const ExecutorGroup&) = delete;
+    ExecutorGroup& operator=(const ExecutorGroup&) = delete;
+
+    /**
+     * @brief Add an executor to the group. It lives as long as the group.
+     * @tparam Callable Callable type of the executor. Requires operator()
+     * with no arguments, and to be movable.
+     * @param weight_ Share of the threads under load, relative to the
+     * weights of the other busy executors. Must be positive.
+     * @return Executor<Callable>& The new executor.
+     */
+    template<class Callable>
+    Executor<Callable> &AddExecutor(size_t weight_ = 1);
+
+    /**
+     * @brief Return the number of executors in the group.
+     */
+    size_t GetNumOfExecutors() const;
+
+    /**
+     * @brief Block until every Callable pushed before the call is done, see
+     * ThreadPool::Drain. Must not be called from one of the group's threads.
+     */
+    void Drain();
+
+    /**
+     * @brief Return the shared Thread Pool, to resize, pause or watch it.
+     * Tasks pushed to it directly take no executor's share.
+     */
+    Pool &GetPool() noexcept { return m_pool; }
+
+private:
+    template<class>
+    friend class Executor;
+
+    static const uint64_t STRIDE = uint64_t(1) << 32;
+
+    /**
+     * @brief Queue of an executor, used under the group's lock.
+     */
+    class Lane
+    {
+    public:
+        explicit Lane(ExecutorGroup &group_, size_t weight_);
+        virtual ~Lane() = default;
+
+        /**
+         * @brief Move out the oldest Callable, unlock guard_ and call it.
+         */
+        virtual void RunFront(std::unique_lock<std::mutex> &guard_) = 0;
+
+        /**
+         * @brief Return the number of Callables queued.
+         */
+        virtual size_t GetQueued() const noexcept = 0;
+
+        /* members ---------------------------------------------------------- */
+        ExecutorGroup  &m_group;
+        uint64_t        m_stride;           // Pass added by every Callable.
+        uint64_t        m_pass;             // Service so far, by weight.
+    };
+
+    /**
+     * @brief Push the Task taking the next Callable, after lane_ queued one
+     * under the lock.
+     * @param was_idle_ Was lane_ empty, it starts at the current pass.
+     * @param guard_ Locked guard of m_lock, unlocked on return.
+     */
+    void Schedule(Lane &lane_, bool was_idle_,
+                  std::unique_lock<std::mutex> &guard_);
+
+    /**
+     * @brief Run the queued Callable of the busy lane with the least pass.
+     */
+    void RunNext();
+
+    /* members -------------------------------------------------------------- */
+    std::vector<std::unique_ptr<Lane>>  m_lanes;
+    uint64_t                            m_pass; // Pass of the last Callable.
+    mutable std::mutex                  m_lock; // Lock of the lanes.
+    Pool                                m_pool; // Destroyed first.
+};
+
+/* -------------------------------------------------------------------------- */
+/* executor                                                                   */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Logical executor of an ExecutorGroup, made by AddExecutor. Holds
+ * it's queued Callables in FIFO order, and runs them on the group's threads.
+ * @tparam Callable Callable type of the executor.
+ */
+template<class Callable>
+class Executor: private ExecutorGroup::Lane
+{
+public:
+    // non-copyable
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    /**
+     * @brief Add a Callable for the group's threads to execute. If the
+     * group's Thread Pool refuses the Task taking it, a queued Callable is
+     * executed by the calling thread instead.
+     * @param call_ Callable object to execute.
+     */
+    void Push(Callable &&call_);
+
+    /**
+     * @brief Return the weight given to AddExecutor.
+     */
+    size_t GetWeight() const noexcept { return m_weight; }
+
+    /**
+     * @brief Return the number of Callables queued, not taken by a thread.
+     */
+    size_t GetSize() const;
+
+private:
+    friend class ExecutorGroup;
+
+    explicit Executor(ExecutorGroup &group_, size_t weight_);
+
+    void RunFront(std::unique_lock<std::mutex> &guard_) override;
+    size_t GetQueued() const noexcept override { return m_calls.size(); }
+
+    /* members -------------------------------------------------------------- */
+    std::deque<Callable>    m_calls;    // Queued, under the group's lock.
+    size_t                  m_weight;
+};
+
+/* implementation ----------------------------------------------------------- */
+
+inline ExecutorGroup::ExecutorGroup():
+    m_lanes(),
+    m_pass(0),
+    m_lock(),
+    m_pool()
+{
+    // Do nothing
+}
+
+inline ExecutorGroup::ExecutorGroup(size_t threads_num_,
+                                    Pool::Scheduling scheduling_,
+                                    const Affinity &affinity_):
+    m_lanes(),
+    m_pass(0),
+    m_lock(),
+    m_pool(threads_num_, scheduling_, affinity_)
+{
+    // Do nothing
+}
+
+template<class Callable>
+Executor<Callable> &ExecutorGroup::AddExecutor(size_t weight_)
+{
+    if (0 == weight_)
+    {
+        throw(std::invalid_argument("Executor weight must be positive."));
+    }
+
+    Executor<Callable> *ret = new Executor<Callable>(*this, weight_);
+    std::unique_ptr<Lane> lane(ret);
+
+    std::unique_lock<std::mutex> guard(m_lock); // Critical section start.
+
+    m_lanes.push_back(std::move(lane));
+
+    return *ret;
+}                                               // Critical section end.
+
+inline size_t ExecutorGroup::GetNumOfExecutors() const
+{
+    std::unique_lock<std::mutex> guard(m_lock);
+
+    return m_lanes.size();
+}
+
+inline void ExecutorGroup::Drain()
+{
+    m_pool.Drain();
+}
+
+inline void ExecutorGroup::Schedule(Lane &lane_, bool was_idle_,
+                                    std::unique_lock<std::mutex> &guard_)
+{
+    // An idle lane gets no credit for the time it was idle.
+    if (was_idle_) lane_.m_pass = std::max(lane_.m_pass, m_pass);
+
+    guard_.unlock();
+
+    // Every Task takes one Callable, of whichever lane is next.
+    if (!m_pool.Push(Task([this](){ RunNext(); }))) RunNext();
+}
+
+inline void ExecutorGroup::RunNext()
+{
+    std::unique_lock<std::mutex> guard(m_lock);
+
+    Lane *next = nullptr;
+
+    for (const std::unique_ptr<Lane> &lane : m_lanes)
+    {
+        if (0 != lane->GetQueued() && (!next || lane->m_pass < next->m_pass))
+        {
+            next = lane.get();
+        }
+    }
+
+    // A Task per queued Callable, so one is always found.
+    m_pass = next->m_pass;
+    next->m_pass += next->m_stride;
+
+    // Unlocks before the call.
+    next->RunFront(guard);
+}
+
+inline ExecutorGroup::Lane::Lane(ExecutorGroup &group_, size_t weight_):
+    m_group(group_),
+    m_stride(STRIDE / weight_),
+    m_pass(0)
+{
+    // Do nothing
+}
+
+/* -------------------------------------------------------------------------- */
+
+template<class Callable>
+Executor<Callable>::Executor(ExecutorGroup &group_, size_t weight_):
+    ExecutorGroup::Lane(group_, weight_),
+    m_calls(),
+    m_weight(weight_)
+{
+    // Do nothing
+}
+
+template<class Callable>
+void Executor<Callable>::Push(Callable &&call_)
+{
+    std::unique_lock<std::mutex> guard(m_group.m_lock);
+
+    bool was_idle = m_calls.empty();
+    m_calls.push_back(std::move(call_));
+
+    m_group.Schedule(*this, was_idle, guard);
+}
+
+template<class Callable>
+size_t Executor<Callable>::GetSize() const
+{
+    std::unique_lock<std::mutex> guard(m_group.m_lock);
+
+    return m_calls.size();
+}
+
+template<class Callable>
+void Executor<Callable>::RunFront(std::unique_lock<std::mutex> &guard_)
+{
+    Callable call(std::move(m_calls.front()));
+    m_calls.pop_front();
+
+    guard_.unlock();
+
+    call();
+}
+
+/* -------------------------------------------------------------------------- */
+#endif /* __DP_EXECUTOR_GROUP_HPP__ */
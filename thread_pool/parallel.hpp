@@ -0,0 +1,276 @@
+/* -------------------------------------------------------------------------- */
+/* parallel.hpp                                                               */
+/* -------------------------------------------------------------------------- */
+
+#ifndef __DP_PARALLEL_HPP__
+#define __DP_PARALLEL_HPP__
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <algorithm>            // std::min, std::max
+#include <atomic>               // std::atomic
+#include <cstddef>              // size_t
+#include <exception>            // std::exception_ptr
+#include <iterator>             // std::begin, std::end, std::distance
+#include <memory>               // std::shared_ptr, std::make_shared
+#include <mutex>                // std::mutex, std::unique_lock
+#include <thread>               // std::this_thread::yield
+#include <utility>              // std::move
+
+#include <thread_pool/task.hpp>
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Parallel loops over a ThreadPool<Task>. The index range is split into
+ * chunks claimed from a shared cursor. Chunks are large at the start and
+ * shrink as the work runs out (guided scheduling), down to grain_ indexes,
+ * so the queue gets at most one Task per thread and the threads still finish
+ * together. The calling thread claims chunks too, and only waits for chunks
+ * already running on other threads. The first exception thrown by the body
+ * stops the loop and is rethrown on the calling thread.
+ */
+
+namespace details
+{
+
+/**
+ * @brief State of a single parallel loop, shared with the pool's threads.
+ * A thread that starts after the loop is done finds no chunk to claim, and
+ * never touches the body.
+ */
+template<class Body>
+class ChunkLoop
+{
+public:
+    ChunkLoop(size_t size_, size_t grain_, size_t threads_, Body &body_):
+        m_size(size_), m_grain(std::max<size_t>(grain_, 1)),
+        m_threads(std::max<size_t>(threads_, 1)), m_body(&body_),
+        m_next(0), m_done(0), m_exception(), m_lock()
+    {}
+
+    /**
+     * @brief Claim and run chunks until none are left.
+     */
+    void Work()
+    {
+        size_t begin = 0;
+        size_t end = 0;
+
+        while (Claim(begin, end))
+        {
+            try
+            {
+                (*m_body)(begin, end);
+            }
+            catch (...)
+            {
+                Cancel(std::current_exception());
+            }
+
+            m_done.fetch_add(end - begin, std::memory_order_release);
+        }
+    }
+
+    /**
+     * @brief Wait for the chunks running on other threads, and rethrow.
+     */
+    void Join()
+    {
+        while (m_done.load(std::memory_order_acquire) < m_size)
+        {
+            std::this_thread::yield();
+        }
+
+        if (m_exception) std::rethrow_exception(m_exception);
+    }
+
+private:
+    bool Claim(size_t &begin_, size_t &end_)
+    {
+        size_t next = m_next.load(std::memory_order_relaxed);
+        size_t chunk = 0;
+
+        do
+        {
+            if (next >= m_size) return false;
+
+            chunk = std::max(m_grain, (m_size - next) / (2 * m_threads));
+            end_ = std::min(m_size, next + chunk);
+        }
+        while (!m_next.compare_exchange_weak(next, end_,
+                                             std::memory_order_relaxed));
+
+        begin_ = next;
+
+        return true;
+    }
+
+    void Cancel(std::exception_ptr exception_)
+    {
+        std::unique_lock<std::mutex> guard(m_lock); // Critical section start.
+
+        if (!m_exception) m_exception = exception_;
+
+        // Skip the chunks no thread claimed yet, count them as done.
+        size_t next = m_next.exchange(m_size, std::memory_order_relaxed);
+        if (next < m_size)
+        {
+            m_done.fetch_add(m_size - next, std::memory_order_release);
+        }
+    }                                               // Critical section end.
+
+    /* members -------------------------------------------------------------- */
+    const size_t        m_size;         // Number of indexes.
+    const size_t        m_grain;        // Smallest chunk size.
+    const size_t        m_threads;      // Threads taking part.
+    Body               *m_body;         // Called with [begin, end).
+    std::atomic<size_t> m_next;         // First index not claimed yet.
+    std::atomic<size_t> m_done;         // Indexes done or skipped.
+    std::exception_ptr  m_exception;    // First exception thrown.
+    std::mutex          m_lock;         // Lock for m_exception.
+};
+
+/**
+ * @brief Run body_ on chunks of [0, size_) on pool_ and the calling thread.
+ * @param body_ Called with (begin, end) of every chunk.
+ */
+template<class Pool, class Body>
+void ForChunks(Pool &pool_, size_t size_, size_t grain_, Body &body_)
+{
+    if (0 == size_) return;
+
+    size_t threads = pool_.GetSize() + 1;
+    auto loop = std::make_shared<ChunkLoop<Body>>(size_, grain_, threads,
+                                                  body_);
+
+    // No more helpers than chunks of grain_ the caller would leave.
+    size_t helpers = std::min(threads - 1, (size_ - 1) / std::max<size_t>(
+                                               grain_, 1));
+
+    for (size_t i = 0; i < helpers; ++i)
+    {
+        if (!pool_.Push(Task([loop](){ loop->Work(); }))) break;
+    }
+
+    loop->Work();
+    loop->Join();
+}
+
+} // namespace details
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Call body_(i) for every index i in [first_, last_), in parallel.
+ * @tparam Pool ThreadPool with Task as it's Callable.
+ * @tparam Index Integral index type.
+ * @param pool_ Thread Pool to execute on, with the calling thread.
+ * @param first_ First index.
+ * @param last_ End index.
+ * @param body_ Callable object, called with each index.
+ * @param grain_ Smallest number of indexes run as one Task.
+ */
+template<class Pool, class Index, class Body>
+void ParallelFor(Pool &pool_, Index first_, Index last_, Body &&body_,
+                 size_t grain_ = 1)
+{
+    if (last_ <= first_) return;
+
+    auto chunk = [&](size_t begin_, size_t end_)
+    {
+        for (size_t i = begin_; i < end_; ++i)
+        {
+            body_(static_cast<Index>(first_ + i));
+        }
+    };
+
+    details::ForChunks(pool_, static_cast<size_t>(last_ - first_), grain_,
+                       chunk);
+}
+
+/**
+ * @brief Call body_(element) for every element of range_, in parallel.
+ * @tparam Range Range with random access iterators.
+ * @param body_ Callable object, called with a reference to each element.
+ */
+template<class Pool, class Range, class Body>
+void ParallelForEach(Pool &pool_, Range &range_, Body &&body_,
+                     size_t grain_ = 1)
+{
+    auto first = std::begin(range_);
+
+    auto chunk = [&](size_t begin_, size_t end_)
+    {
+        for (size_t i = begin_; i < end_; ++i) body_(first[i]);
+    };
+
+    details::ForChunks(pool_, static_cast<size_t>(
+                           std::distance(first, std::end(range_))),
+                       grain_, chunk);
+}
+
+/**
+ * @brief Store func_(first_[i]) to out_[i] for every element of
+ * [first_, last_), in parallel.
+ * @tparam InIterator Random access iterator.
+ * @tparam OutIterator Random access iterator.
+ */
+template<class Pool, class InIterator, class OutIterator, class Func>
+void ParallelTransform(Pool &pool_, InIterator first_, InIterator last_,
+                       OutIterator out_, Func &&func_, size_t grain_ = 1)
+{
+    auto chunk = [&](size_t begin_, size_t end_)
+    {
+        for (size_t i = begin_; i < end_; ++i) out_[i] = func_(first_[i]);
+    };
+
+    details::ForChunks(pool_, static_cast<size_t>(std::distance(first_, last_)),
+                       grain_, chunk);
+}
+
+/**
+ * @brief Reduce [first_, last_) with reduce_, in parallel. Every chunk is
+ * reduced on it's own, and the chunk results are combined in no particular
+ * order, so reduce_ must be associative and commutative.
+ * @tparam Iterator Random access iterator.
+ * @tparam T Result type.
+ * @param init_ Initial value, combined with the reduction of the elements
+ * once, whatever the number of chunks.
+ * @param identity_ Identity of reduce_, such as 0 for a sum. Every chunk
+ * starts from a copy of it.
+ * @param reduce_ Callable object. Called as reduce_(T, element) for every
+ * element within a chunk, and reduce_(T, T) to combine chunks.
+ * @return T Reduction of init_ and all the elements.
+ */
+template<class Pool, class Iterator, class T, class Reduce>
+T ParallelReduce(Pool &pool_, Iterator first_, Iterator last_, T init_,
+                 const T &identity_, Reduce &&reduce_, size_t grain_ = 1)
+{
+    std::mutex lock;
+    T total(identity_);
+
+    auto chunk = [&](size_t begin_, size_t end_)
+    {
+        // Every element goes through reduce_, the first one as well.
+        T partial(identity_);
+        for (size_t i = begin_; i < end_; ++i)
+        {
+            partial = reduce_(std::move(partial), first_[i]);
+        }
+
+        std::unique_lock<std::mutex> guard(lock);   // Critical section start.
+
+        total = reduce_(std::move(total), std::move(partial));
+    };                                              // Critical section end.
+
+    details::ForChunks(pool_, static_cast<size_t>(std::distance(first_, last_)),
+                       grain_, chunk);
+
+    return reduce_(std::move(init_), std::move(total));
+}
+
+/* -------------------------------------------------------------------------- */
+#endif /* __DP_PARALLEL_HPP__ */
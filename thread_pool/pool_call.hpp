@@ -0,0 +1,110 @@
+/* -------------------------------------------------------------------------- */
+/* pool_call.hpp                                                              */
+/* -------------------------------------------------------------------------- */
+
+#ifndef __DP_POOL_CALL_HPP__
+#define __DP_POOL_CALL_HPP__
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <cstddef>              // size_t
+#include <exception>            // std::exception_ptr
+#include <functional>           // std::function
+#include <future>               // std::promise
+#include <tuple>                // std::make_tuple, std::apply
+#include <type_traits>          // std::invoke_result_t
+#include <utility>              // std::move, std::forward
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Steps shared by the threads of ThreadPool and StaticThreadPool: calling a
+ * popped Callable between the statistics hooks, passing what it throws to
+ * the error callback, and packing a Submit into a Callable.
+ */
+
+namespace details
+{
+
+/**
+ * @brief Pass exception_ to on_error_, dropping what it throws. Does nothing
+ * without a callback. Never throws, the calling thread must not end.
+ */
+inline void PassError(
+    const std::function<void(std::exception_ptr)> &on_error_,
+    std::exception_ptr exception_) noexcept
+{
+    if (!on_error_) return;
+
+    try
+    {
+        on_error_(std::move(exception_));
+    }
+    catch (...)
+    {
+        // Dropped, the thread must not end.
+    }
+}
+
+/**
+ * @brief Call a popped Callable on the thread of slot_, recorded by stats_.
+ * @param on_error_ Called with no arguments inside the handler of anything
+ * the Callable throws. Must not throw.
+ */
+template<class Stats, class Entry, class OnError>
+inline void RunEntry(Stats &stats_, size_t slot_, Entry &call_,
+                     OnError &&on_error_)
+{
+    stats_.OnStart(slot_, call_);
+
+    // Costs nothing unless thrown, the thread lives on either way.
+    try
+    {
+        call_();
+    }
+    catch (...)
+    {
+        on_error_();
+    }
+
+    stats_.OnEnd(slot_);
+}
+
+/**
+ * @brief Return a Callable calling func_ with args_ and setting promise_ to
+ * it's result, or to the exception it throws. Promise, function and
+ * arguments are stored inside the Callable itself.
+ */
+template<class Result, class Func, class... Args>
+auto MakeSubmitCall(std::promise<Result> promise_, Func &&func_,
+                    Args&&... args_)
+{
+    return [promise = std::move(promise_), func = std::forward<Func>(func_),
+            args = std::make_tuple(std::forward<Args>(args_)...)]
+            () mutable
+    {
+        try
+        {
+            if constexpr (std::is_void<Result>::value)
+            {
+                std::apply(func, std::move(args));
+                promise.set_value();
+            }
+            else
+            {
+                promise.set_value(std::apply(func, std::move(args)));
+            }
+        }
+        catch (...)
+        {
+            promise.set_exception(std::current_exception());
+        }
+    };
+}
+
+} // namespace details
+
+/* -------------------------------------------------------------------------- */
+#endif /* __DP_POOL_CALL_HPP__ */
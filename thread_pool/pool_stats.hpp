@@ -0,0 +1,346 @@
+/* -------------------------------------------------------------------------- */
+/* pool_stats.hpp                                                             */
+/* -------------------------------------------------------------------------- */
+
+#ifndef __DP_POOL_STATS_HPP__
+#define __DP_POOL_STATS_HPP__
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <atomic>               // std::atomic
+#include <chrono>               // std::chrono::steady_clock
+#include <cstddef>              // size_t
+#include <cstdint>              // uint64_t
+#include <utility>              // std::move
+#include <vector>               // std::vector
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Statistics policies for the ThreadPool. A policy must provide:
+ *  Entry<Callable>             - Type stored in the queues for a Callable.
+ *  Snapshot                    - Type returned by GetSnapshot().
+ *  Policy(size_t slots_)       - Constructor, given the number of slots.
+ *  OnPush(size_t n)            - n Callables were pushed.
+ *  OnDrop(size_t n)            - n queued Callables were dropped for space.
+ *  OnStart(slot_, entry_)      - Thread in slot_ starts executing entry_.
+ *  OnEnd(slot_)                - Thread in slot_ is done executing.
+ *  OnCancel(slot_)             - Thread in slot_ dropped a cancelled Callable.
+ *  OnIdleBegin/End(slot_)      - Thread in slot_ waits for an action.
+ *  OnSteal(slot_, victim_)     - Thread in slot_ took a Callable from the
+ *                                queue of victim_ (STEALING only).
+ *  Now()                       - Current time, for OnTransition().
+ *  OnTransition(start_, kind_) - A Pause or resize started at start_ ended.
+ *  GetSnapshot() const         - Current statistics.
+ */
+
+/**
+ * @brief Kind of a transition passed to OnTransition().
+ */
+enum class Transition
+{
+    PAUSE,
+    RESIZE
+};
+
+/* -------------------------------------------------------------------------- */
+/* no statistics                                                              */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Statistics policy that records nothing. Every hook is empty and is
+ * compiled away.
+ */
+class NoStats
+{
+public:
+    template<class Callable>
+    using Entry = Callable;
+
+    struct Snapshot {};
+
+    explicit NoStats(size_t) noexcept {}
+
+    void OnPush(size_t) noexcept {}
+    void OnDrop(size_t) noexcept {}
+    template<class Call>
+    void OnStart(size_t, const Call&) noexcept {}
+    void OnEnd(size_t) noexcept {}
+    void OnCancel(size_t) noexcept {}
+    void OnIdleBegin(size_t) noexcept {}
+    void OnIdleEnd(size_t) noexcept {}
+    void OnSteal(size_t, size_t) noexcept {}
+    uint64_t Now() const noexcept { return 0; }
+    void OnTransition(uint64_t, Transition) noexcept {}
+
+    Snapshot GetSnapshot() const noexcept { return Snapshot(); }
+};
+
+/* -------------------------------------------------------------------------- */
+/* pool statistics                                                            */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Statistics of a ThreadPool at some point in time. Histogram bucket i
+ * counts durations in [2^i, 2^(i+1)) nanoseconds, and the last bucket
+ * everything above.
+ */
+struct StatsSnapshot
+{
+    static const size_t BUCKETS = 40;
+
+    size_t      m_pushed;                   // Callables pushed.
+    size_t      m_completed;                // Callables executed.
+    size_t      m_cancelled;                // Callables dropped, cancelled.
+    size_t      m_dropped;                  // Callables dropped for space.
+    size_t      m_depth;                    // Callables waiting in the queue.
+    uint64_t    m_wait_histogram[BUCKETS];  // Time from Push to execution.
+    uint64_t    m_run_histogram[BUCKETS];   // Time executing.
+    uint64_t    m_idle_ns;                  // Time threads waited for action.
+    uint64_t    m_transition_ns;            // Time in Pause/SetNumOfThreads.
+    size_t      m_transitions;              // Number of Pause/SetNumOfThreads.
+};
+
+/**
+ * @brief Statistics policy that records counters and histograms. Every
+ * thread writes only to it's own slot, so recording needs no locks and no
+ * read-modify-write operations.
+ */
+class PoolStats
+{
+public:
+    typedef StatsSnapshot Snapshot;
+
+    /**
+     * @brief Callable stamped with it's Push time.
+     */
+    template<class Callable>
+    struct Entry
+    {
+        Entry() = default;
+
+        Entry(Callable &&call_):
+            m_call(std::move(call_)), m_pushed(PoolStats::Clock())
+        {}
+
+        void operator()() { m_call(); }
+
+        friend bool operator<(const Entry &lhs_, const Entry &rhs_)
+        {
+            return (lhs_.m_call < rhs_.m_call);
+        }
+
+        int GetPriority() const { return m_call.GetPriority(); }
+
+        Callable    m_call;             // Callable to execute.
+        uint64_t    m_pushed = 0;       // Push time in nanoseconds.
+    };
+
+    /**
+     * @brief Construct a new Pool Stats object.
+     * @param slots_ Number of thread slots in the ThreadPool.
+     */
+    explicit PoolStats(size_t slots_);
+
+    // non-copyable
+    PoolStats(const PoolStats&) = delete;
+    PoolStats& operator=(const PoolStats&) = delete;
+
+    void OnPush(size_t n) noexcept;
+    void OnDrop(size_t n) noexcept;
+    template<class Callable>
+    void OnStart(size_t slot_, const Entry<Callable> &entry_) noexcept;
+    void OnEnd(size_t slot_) noexcept;
+    void OnCancel(size_t slot_) noexcept;
+    void OnIdleBegin(size_t slot_) noexcept;
+    void OnIdleEnd(size_t slot_) noexcept;
+    void OnSteal(size_t, size_t) noexcept {}
+    uint64_t Now() const noexcept;
+    void OnTransition(uint64_t start_, Transition kind_) noexcept;
+
+    /**
+     * @brief Sum the statistics of all the slots.
+     * @return Snapshot Current statistics.
+     */
+    Snapshot GetSnapshot() const noexcept;
+
+    /**
+     * @brief Return the steady clock time in nanoseconds.
+     */
+    static uint64_t Clock() noexcept;
+
+private:
+    static const size_t BUCKETS = StatsSnapshot::BUCKETS;
+
+    /**
+     * @brief Statistics of a single thread slot, on it's own cache lines.
+     */
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t>   m_wait[BUCKETS];    // Wait time histogram.
+        std::atomic<uint64_t>   m_run[BUCKETS];     // Run time histogram.
+        std::atomic<uint64_t>   m_started;          // Callables started.
+        std::atomic<uint64_t>   m_completed;        // Callables completed.
+        std::atomic<uint64_t>   m_cancelled;        // Callables dropped.
+        std::atomic<uint64_t>   m_idle_ns;          // Time waiting for action.
+        uint64_t                m_mark;             // Start/idle begin time.
+    };
+
+    /**
+     * @brief Add n to a counter written only by the calling thread.
+     */
+    static void Add(std::atomic<uint64_t> &counter_, uint64_t n) noexcept;
+
+    /**
+     * @brief Return the histogram bucket of a duration.
+     */
+    static size_t Bucket(uint64_t ns_) noexcept;
+
+    /* members -------------------------------------------------------------- */
+    std::vector<Slot>   m_slots;            // Per thread statistics.
+    alignas(64)
+    std::atomic<size_t> m_pushed;           // Written by any pushing thread.
+    std::atomic<size_t> m_dropped;          // Callables dropped for space.
+    alignas(64)
+    std::atomic<uint64_t> m_transition_ns;  // Written by controlling threads.
+    std::atomic<size_t> m_transitions;      // Number of transitions.
+};
+
+/* implementation ----------------------------------------------------------- */
+
+inline PoolStats::PoolStats(size_t slots_):
+    m_slots(slots_),
+    m_pushed(0),
+    m_dropped(0),
+    m_transition_ns(0),
+    m_transitions(0)
+{
+    for (Slot &slot : m_slots)
+    {
+        for (size_t i = 0; i < BUCKETS; ++i)
+        {
+            slot.m_wait[i].store(0, std::memory_order_relaxed);
+            slot.m_run[i].store(0, std::memory_order_relaxed);
+        }
+
+        slot.m_started.store(0, std::memory_order_relaxed);
+        slot.m_completed.store(0, std::memory_order_relaxed);
+        slot.m_cancelled.store(0, std::memory_order_relaxed);
+        slot.m_idle_ns.store(0, std::memory_order_relaxed);
+        slot.m_mark = 0;
+    }
+}
+
+inline void PoolStats::OnPush(size_t n) noexcept
+{
+    m_pushed.fetch_add(n, std::memory_order_relaxed);
+}
+
+inline void PoolStats::OnDrop(size_t n) noexcept
+{
+    m_dropped.fetch_add(n, std::memory_order_relaxed);
+}
+
+template<class Callable>
+inline void PoolStats::OnStart(size_t slot_,
+                               const Entry<Callable> &entry_) noexcept
+{
+    Slot &slot = m_slots[slot_];
+
+    slot.m_mark = Clock();
+    Add(slot.m_started, 1);
+    Add(slot.m_wait[Bucket(slot.m_mark - entry_.m_pushed)], 1);
+}
+
+inline void PoolStats::OnEnd(size_t slot_) noexcept
+{
+    Slot &slot = m_slots[slot_];
+
+    Add(slot.m_run[Bucket(Clock() - slot.m_mark)], 1);
+    Add(slot.m_completed, 1);
+}
+
+inline void PoolStats::OnCancel(size_t slot_) noexcept
+{
+    Add(m_slots[slot_].m_cancelled, 1);
+}
+
+inline void PoolStats::OnIdleBegin(size_t slot_) noexcept
+{
+    m_slots[slot_].m_mark = Clock();
+}
+
+inline void PoolStats::OnIdleEnd(size_t slot_) noexcept
+{
+    Slot &slot = m_slots[slot_];
+
+    Add(slot.m_idle_ns, Clock() - slot.m_mark);
+}
+
+inline uint64_t PoolStats::Now() const noexcept
+{
+    return Clock();
+}
+
+inline void PoolStats::OnTransition(uint64_t start_, Transition) noexcept
+{
+    m_transition_ns.fetch_add(Clock() - start_, std::memory_order_relaxed);
+    m_transitions.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline PoolStats::Snapshot PoolStats::GetSnapshot() const noexcept
+{
+    Snapshot ret = Snapshot();
+    size_t started = 0;
+
+    for (const Slot &slot : m_slots)
+    {
+        for (size_t i = 0; i < BUCKETS; ++i)
+        {
+            ret.m_wait_histogram[i] +=
+                slot.m_wait[i].load(std::memory_order_relaxed);
+            ret.m_run_histogram[i] +=
+                slot.m_run[i].load(std::memory_order_relaxed);
+        }
+
+        started += slot.m_started.load(std::memory_order_relaxed);
+        ret.m_completed += slot.m_completed.load(std::memory_order_relaxed);
+        ret.m_cancelled += slot.m_cancelled.load(std::memory_order_relaxed);
+        ret.m_idle_ns += slot.m_idle_ns.load(std::memory_order_relaxed);
+    }
+
+    ret.m_pushed = m_pushed.load(std::memory_order_relaxed);
+    ret.m_dropped = m_dropped.load(std::memory_order_relaxed);
+    started += ret.m_cancelled + ret.m_dropped;
+    ret.m_depth = (ret.m_pushed > started) ? ret.m_pushed - started : 0;
+    ret.m_transition_ns = m_transition_ns.load(std::memory_order_relaxed);
+    ret.m_transitions = m_transitions.load(std::memory_order_relaxed);
+
+    return ret;
+}
+
+inline uint64_t PoolStats::Clock() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+inline void PoolStats::Add(std::atomic<uint64_t> &counter_,
+                           uint64_t n) noexcept
+{
+    counter_.store(counter_.load(std::memory_order_relaxed) + n,
+                   std::memory_order_relaxed);
+}
+
+inline size_t PoolStats::Bucket(uint64_t ns_) noexcept
+{
+    size_t bucket = 63 - __builtin_clzll(ns_ | 1);
+
+    return (bucket < BUCKETS) ? bucket : BUCKETS - 1;
+}
+
+/* -------------------------------------------------------------------------- */
+#endif /* __DP_POOL_STATS_HPP__ */
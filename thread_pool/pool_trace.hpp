@@ -0,0 +1,325 @@
+/* -------------------------------------------------------------------------- */
+/* pool_trace.hpp                                                             */
+/* -------------------------------------------------------------------------- */
+
+#ifndef __DP_POOL_TRACE_HPP__
+#define __DP_POOL_TRACE_HPP__
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <atomic>               // std::atomic, std::atomic_thread_fence
+#include <cstddef>              // size_t
+#include <cstdint>              // uint32_t, uint64_t
+#include <iomanip>              // std::setprecision
+#include <ostream>              // std::ostream
+#include <sstream>              // std::ostringstream
+#include <string>               // std::string
+#include <vector>               // std::vector
+
+#include <thread_pool/pool_stats.hpp>
+
+/* -------------------------------------------------------------------------- */
+/* pool trace                                                                 */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Statistics policy that records a timeline: every Callable's start,
+ * end and Push time, every steal and cancelled Callable dropped, and every
+ * Pause and resize. Every thread
+ * slot writes to it's own ring buffer of the last Capacity events, without
+ * locks; Pauses and resizes go to a shared ring. GetSnapshot() returns the
+ * events as Chrome trace JSON, which chrome://tracing and the Perfetto UI
+ * open as a track per thread, showing stragglers and idle gaps.
+ * @tparam Capacity Number of events kept per thread slot.
+ */
+template<size_t Capacity = 4096>
+class PoolTrace
+{
+public:
+    typedef std::string Snapshot;
+
+    template<class Callable>
+    using Entry = PoolStats::Entry<Callable>;
+
+    /**
+     * @brief Construct a new Pool Trace object.
+     * @param slots_ Number of thread slots in the ThreadPool.
+     */
+    explicit PoolTrace(size_t slots_);
+
+    // non-copyable
+    PoolTrace(const PoolTrace&) = delete;
+    PoolTrace& operator=(const PoolTrace&) = delete;
+
+    void OnPush(size_t) noexcept {}
+    void OnDrop(size_t) noexcept {}
+    template<class Callable>
+    void OnStart(size_t slot_, const Entry<Callable> &entry_) noexcept;
+    void OnEnd(size_t slot_) noexcept;
+    void OnCancel(size_t slot_) noexcept;
+    void OnIdleBegin(size_t) noexcept {}
+    void OnIdleEnd(size_t) noexcept {}
+    void OnSteal(size_t slot_, size_t victim_) noexcept;
+    uint64_t Now() const noexcept;
+    void OnTransition(uint64_t start_, Transition kind_) noexcept;
+
+    /**
+     * @brief Return the events recorded so far as Chrome trace JSON.
+     */
+    Snapshot GetSnapshot() const;
+
+    /**
+     * @brief Write the events recorded so far as Chrome trace JSON.
+     * @param out_ Stream to write to.
+     */
+    void Dump(std::ostream &out_) const;
+
+private:
+    enum Kind : uint32_t
+    {
+        TASK,                           // m_arg is the time queued.
+        STEAL,                          // m_arg is the victim's slot.
+        CANCEL,
+        PAUSE,
+        RESIZE
+    };
+
+    /**
+     * @brief Recorded event. m_seq is it's index in the ring plus 1 once
+     * written, 0 while being written, so a reader skips torn events.
+     */
+    struct Event
+    {
+        std::atomic<uint64_t>   m_seq;
+        std::atomic<uint64_t>   m_time;     // Start time in nanoseconds.
+        std::atomic<uint64_t>   m_duration; // Duration in nanoseconds.
+        std::atomic<uint64_t>   m_arg;      // Argument, see Kind.
+        std::atomic<uint32_t>   m_kind;
+    };
+
+    /**
+     * @brief Ring of the last Capacity events, on it's own cache lines.
+     */
+    struct alignas(64) Ring
+    {
+        Event                   m_events[Capacity];
+        std::atomic<uint64_t>   m_head;     // Number of events recorded.
+        uint64_t                m_mark;     // Start of the current Callable.
+        uint64_t                m_queued;   // Wait of the current Callable.
+    };
+
+    /**
+     * @brief Write an event to index_ of ring_. The writer of a slot's ring
+     * moves it's head after, the controlling threads claim theirs before.
+     */
+    static void Write(Ring &ring_, uint64_t index_, Kind kind_,
+                      uint64_t time_, uint64_t duration_,
+                      uint64_t arg_) noexcept;
+
+    /**
+     * @brief Write the events of ring_ as JSON objects on track tid_.
+     * @param is_first_ Was no event written yet, updated.
+     */
+    void DumpRing(std::ostream &out_, const Ring &ring_, size_t tid_,
+                  bool &is_first_) const;
+
+    /* members -------------------------------------------------------------- */
+    std::vector<Ring>   m_slots;            // Written by their thread only.
+    Ring                m_control;          // Written by controlling threads.
+    uint64_t            m_base;             // Time of timeline 0.
+};
+
+/* implementation ----------------------------------------------------------- */
+
+template<size_t Capacity>
+PoolTrace<Capacity>::PoolTrace(size_t slots_):
+    m_slots(slots_),
+    m_control(),
+    m_base(PoolStats::Clock())
+{
+    // Do nothing
+}
+
+template<size_t Capacity>
+template<class Callable>
+inline void PoolTrace<Capacity>::OnStart(size_t slot_,
+                                         const Entry<Callable> &entry_)
+                                         noexcept
+{
+    Ring &ring = m_slots[slot_];
+
+    ring.m_mark = PoolStats::Clock();
+    ring.m_queued = ring.m_mark - entry_.m_pushed;
+}
+
+template<size_t Capacity>
+inline void PoolTrace<Capacity>::OnEnd(size_t slot_) noexcept
+{
+    Ring &ring = m_slots[slot_];
+    uint64_t index = ring.m_head.load(std::memory_order_relaxed);
+
+    Write(ring, index, TASK, ring.m_mark, PoolStats::Clock() - ring.m_mark,
+          ring.m_queued);
+    ring.m_head.store(index + 1, std::memory_order_release);
+}
+
+template<size_t Capacity>
+inline void PoolTrace<Capacity>::OnSteal(size_t slot_, size_t victim_)
+                                         noexcept
+{
+    Ring &ring = m_slots[slot_];
+    uint64_t index = ring.m_head.load(std::memory_order_relaxed);
+
+    Write(ring, index, STEAL, PoolStats::Clock(), 0, victim_);
+    ring.m_head.store(index + 1, std::memory_order_release);
+}
+
+template<size_t Capacity>
+inline void PoolTrace<Capacity>::OnCancel(size_t slot_) noexcept
+{
+    Ring &ring = m_slots[slot_];
+    uint64_t index = ring.m_head.load(std::memory_order_relaxed);
+
+    Write(ring, index, CANCEL, PoolStats::Clock(), 0, 0);
+    ring.m_head.store(index + 1, std::memory_order_release);
+}
+
+template<size_t Capacity>
+inline uint64_t PoolTrace<Capacity>::Now() const noexcept
+{
+    return PoolStats::Clock();
+}
+
+template<size_t Capacity>
+inline void PoolTrace<Capacity>::OnTransition(uint64_t start_,
+                                              Transition kind_) noexcept
+{
+    // Any controlling thread, so the index is claimed.
+    uint64_t index = m_control.m_head.fetch_add(1, std::memory_order_relaxed);
+
+    Write(m_control, index, (Transition::PAUSE == kind_) ? PAUSE : RESIZE,
+          start_, PoolStats::Clock() - start_, 0);
+}
+
+template<size_t Capacity>
+typename PoolTrace<Capacity>::Snapshot PoolTrace<Capacity>::GetSnapshot()
+    const
+{
+    std::ostringstream out;
+    Dump(out);
+
+    return out.str();
+}
+
+template<size_t Capacity>
+void PoolTrace<Capacity>::Dump(std::ostream &out_) const
+{
+    bool is_first = true;
+    std::ios_base::fmtflags flags = out_.flags();
+    std::streamsize precision = out_.precision();
+
+    // Timestamps in microseconds, to the nanosecond.
+    out_ << std::fixed << std::setprecision(3);
+
+    out_ << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+
+    for (size_t slot = 0; slot < m_slots.size(); ++slot)
+    {
+        out_ << (is_first ? "" : ",") << "\n{\"name\": \"thread_name\", "
+             << "\"ph\": \"M\", \"pid\": 0, \"tid\": " << slot
+             << ", \"args\": {\"name\": \"slot " << slot << "\"}}";
+        is_first = false;
+
+        DumpRing(out_, m_slots[slot], slot, is_first);
+    }
+
+    out_ << (is_first ? "" : ",") << "\n{\"name\": \"thread_name\", "
+         << "\"ph\": \"M\", \"pid\": 0, \"tid\": " << m_slots.size()
+         << ", \"args\": {\"name\": \"control\"}}";
+    is_first = false;
+
+    DumpRing(out_, m_control, m_slots.size(), is_first);
+
+    out_ << "\n]}\n";
+
+    out_.flags(flags);
+    out_.precision(precision);
+}
+
+template<size_t Capacity>
+inline void PoolTrace<Capacity>::Write(Ring &ring_, uint64_t index_,
+                                       Kind kind_, uint64_t time_,
+                                       uint64_t duration_,
+                                       uint64_t arg_) noexcept
+{
+    Event &event = ring_.m_events[index_ % Capacity];
+
+    event.m_seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    event.m_time.store(time_, std::memory_order_relaxed);
+    event.m_duration.store(duration_, std::memory_order_relaxed);
+    event.m_arg.store(arg_, std::memory_order_relaxed);
+    event.m_kind.store(kind_, std::memory_order_relaxed);
+
+    event.m_seq.store(index_ + 1, std::memory_order_release);
+}
+
+template<size_t Capacity>
+void PoolTrace<Capacity>::DumpRing(std::ostream &out_, const Ring &ring_,
+                                   size_t tid_, bool &is_first_) const
+{
+    static const char *const NAMES[] = { "task", "steal", "cancel", "pause",
+                                         "resize" };
+
+    uint64_t head = ring_.m_head.load(std::memory_order_acquire);
+    uint64_t first = (head > Capacity) ? head - Capacity : 0;
+
+    for (uint64_t index = first; index < head; ++index)
+    {
+        const Event &event = ring_.m_events[index % Capacity];
+
+        uint64_t seq = event.m_seq.load(std::memory_order_acquire);
+        uint64_t time = event.m_time.load(std::memory_order_relaxed);
+        uint64_t duration = event.m_duration.load(std::memory_order_relaxed);
+        uint64_t arg = event.m_arg.load(std::memory_order_relaxed);
+        uint32_t kind = event.m_kind.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // Still being written, or overwritten since.
+        if (seq != index + 1 ||
+            seq != event.m_seq.load(std::memory_order_relaxed))
+        {
+            continue;
+        }
+
+        double ts = (time > m_base) ? (time - m_base) / 1e3 : 0;
+
+        out_ << (is_first_ ? "" : ",") << "\n{\"name\": \"" << NAMES[kind]
+             << "\", \"pid\": 0, \"tid\": " << tid_ << ", \"ts\": " << ts;
+        is_first_ = false;
+
+        switch (kind)
+        {
+            case TASK:
+                out_ << ", \"ph\": \"X\", \"dur\": " << duration / 1e3
+                     << ", \"args\": {\"queued_us\": " << arg / 1e3 << "}}";
+                break;
+            case STEAL:
+                out_ << ", \"ph\": \"i\", \"s\": \"t\""
+                     << ", \"args\": {\"victim\": " << arg << "}}";
+                break;
+            case CANCEL:
+                out_ << ", \"ph\": \"i\", \"s\": \"t\"}";
+                break;
+            default:
+                out_ << ", \"ph\": \"X\", \"dur\": " << duration / 1e3 << "}";
+                break;
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+#endif /* __DP_POOL_TRACE_HPP__ */
@@ -0,0 +1,379 @@
+/* -------------------------------------------------------------------------- */
+/* static_thread_pool.hpp                                                     */
+/* -------------------------------------------------------------------------- */
+
+#ifndef __DP_STATIC_THREAD_POOL_HPP__
+#define __DP_STATIC_THREAD_POOL_HPP__
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <array>                // std::array
+#include <atomic>               // std::atomic
+#include <cstddef>              // size_t
+#include <exception>            // std::exception_ptr
+#include <functional>           // std::function
+#include <future>               // std::future, std::promise
+#include <iterator>             // std::begin, std::end, std::distance
+#include <thread>               // std::thread
+#include <type_traits>          // std::invoke_result_t
+#include <utility>              // std::move
+
+#include <thread_pool/pool_call.hpp>
+#include <thread_pool/pool_stats.hpp>
+#include <thread_pool/task_queue.hpp>
+#include <tools/affinity/affinity.hpp>
+#include <tools/semaphore/semaphore.hpp>
+
+/* -------------------------------------------------------------------------- */
+/* static thread pool                                                         */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief ThreadPool with it's configuration fixed at compile time, for hot
+ * paths that use none of the runtime controls. The number of threads is a
+ * template argument, and there is no pause, resize, drain, timers, overflow
+ * policies or cancellation: a thread waits for an action, pops a Callable
+ * and calls it, with no run permit or status check in between, and a Push
+ * is a count of the pushes in flight, a load of a flag, a queue push and a
+ * post. Push, PushBatch and Submit may run with Finish, as on ThreadPool.
+ * Statistics compile away with NoStats. Use ThreadPool for any of the other
+ * features.
+ * @tparam Callable Callable type, requires operator() with no arguments and
+ * a default constructor. See ThreadPool.
+ * @tparam Threads Number of threads, made on construction.
+ * @tparam Container Queue of the Callables, see task_queue.hpp.
+ * PriorityQueue by default.
+ * @tparam Stats Statistics policy, see pool_stats.hpp. NoStats by default.
+ */
+template<class Callable, size_t Threads,
+         class Container = PriorityQueue<Callable>, class Stats = NoStats>
+class StaticThreadPool
+{
+    static_assert(0 < Threads, "StaticThreadPool needs at least 1 thread.");
+
+public:
+    typedef typename Stats::template Entry<Callable> Entry;
+
+    /**
+     * @brief Construct a new Static Thread Pool object and it's threads.
+     * @param affinity_ Placement of the threads on CPUs, by their slot. No
+     * placement by default.
+     * @param on_error_ Called with the exceptions thrown by Callables, by the
+     * thread that caught it. Exceptions are dropped without it. Exceptions it
+     * throws are dropped.
+     */
+    explicit StaticThreadPool(const Affinity &affinity_ = Affinity(),
+                              std::function<void(std::exception_ptr)>
+                                  on_error_ = nullptr);
+
+    /**
+     * @brief Destroy the Static Thread Pool object, without calling the
+     * Callables left.
+     */
+    ~StaticThreadPool();
+
+    // non-copyable
+    StaticThreadPool(const StaticThreadPool&) = delete;
+    StaticThreadPool& operator=(const StaticThreadPool&) = delete;
+
+    /**
+     * @brief Add a Callable object for the threads to execute, copying it.
+     * @param call_ Callable object to execute.
+     * @return bool Did the action succeed. False if finished, or if the
+     * Container is full.
+     */
+    bool Push(const Callable &call_);
+
+    /**
+     * @brief Add a Callable object for the threads to execute, moving it in.
+     * @param call_ Callable object to execute. It is moved from.
+     * @return bool Did the action succeed. False if finished, or if the
+     * Container is full.
+     */
+    bool Push(Callable &&call_);
+
+    /**
+     * @brief Add a batch of Callable objects, with a single post to the
+     * threads. The Callable objects are moved out of the batch.
+     * @tparam Iterator Forward iterator to Callable objects.
+     * @param first_ Beginning of the batch.
+     * @param last_ End of the batch.
+     * @return bool Did the action succeed. False if finished, or if the
+     * Container is full and only part of the batch is added.
+     */
+    template<class Iterator>
+    bool PushBatch(Iterator first_, Iterator last_);
+
+    /**
+     * @brief Same as PushBatch(first_, last_), for a whole range.
+     * @tparam Range Range of Callable objects, such as std::vector.
+     * @param range_ Batch of Callable objects to move out.
+     * @return bool Did the action succeed.
+     */
+    template<class Range>
+    bool PushBatch(Range &range_);
+
+    /**
+     * @brief Add a call of func_ with args_, and get it's result through a
+     * future. Requires Callable to be constructible from a callable object,
+     * such as Task.
+     * @param func_ Function to call.
+     * @param args_ Arguments to call func_ with. They are copied or moved
+     * into the Callable.
+     * @return future Result of the call, or the exception it has thrown.
+     * Invalid if finished, or if the Container is full.
+     */
+    template<class Func, class... Args>
+    std::future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+    Submit(Func &&func_, Args&&... args_);
+
+    /**
+     * @brief End the threads, blocking until they end. Pushes may run
+     * meanwhile: the ones that return true are queued before the threads are
+     * told to stop, the ones after are refused.
+     * @param let_complete_ Should the threads call the Callables left first.
+     * @return bool Did the action succeed. False if already finished.
+     */
+    bool Finish(bool let_complete_ = true);
+
+    /**
+     * @brief Return the number of threads.
+     */
+    static constexpr size_t GetSize() noexcept { return Threads; }
+
+    /**
+     * @brief Return the Static Thread Pool's statistics.
+     * @return Stats::Snapshot Current statistics. Empty with NoStats.
+     */
+    typename Stats::Snapshot GetStats() const;
+
+private:
+    typedef typename Container::template Rebind<Entry> Queue;
+
+    /**
+     * @brief Iterator over a batch of Callables, moving them into Entries.
+     */
+    template<class Iterator>
+    struct EntryIterator
+    {
+        Entry operator*() const { return Entry(std::move(*m_it)); }
+        EntryIterator &operator++() { ++m_it; return *this; }
+        bool operator!=(const EntryIterator &other_) const
+        {
+            return (m_it != other_.m_it);
+        }
+
+        Iterator        m_it;           // Current Callable.
+    };
+
+    /**
+     * @brief Counts a push in flight for it's scope, for Finish to wait on.
+     */
+    struct PushScope
+    {
+        explicit PushScope(std::atomic<size_t> &pushing_): m_pushing(pushing_)
+        {
+            ++m_pushing;
+        }
+        ~PushScope() { m_pushing.fetch_sub(1, std::memory_order_release); }
+
+        // non-copyable
+        PushScope(const PushScope&) = delete;
+        PushScope& operator=(const PushScope&) = delete;
+
+        std::atomic<size_t> &m_pushing;
+    };
+
+    /**
+     * @brief Main loop of the thread of slot_.
+     */
+    void ThreadLoop(size_t slot_);
+
+    /* members -------------------------------------------------------------- */
+    // Read mostly.
+    std::atomic<bool>       m_is_finished;  // Push refused once set.
+    std::atomic<bool>       m_is_stopping;  // Threads end when out of calls.
+    std::atomic<bool>       m_is_dropping;  // Threads end on their action.
+    Affinity                m_affinity;     // Placement of the threads.
+    std::function<void(std::exception_ptr)>
+                            m_on_error;     // Callback for thrown exceptions.
+    std::array<std::thread, Threads>
+                            m_threads;
+
+    // Written by both the pushing threads and the threads.
+    alignas(64) std::atomic<size_t>
+                            m_pushing;      // Pushes past the m_is_finished
+                                            // check, not done yet.
+    alignas(64) Queue       m_calls;        // Callable objects queue.
+    alignas(64) Semaphore   m_actions;      // Number of actions available.
+    alignas(64) Stats       m_stats;        // Statistics policy.
+};
+
+/* implementation ----------------------------------------------------------- */
+
+template<class Callable, size_t Threads, class Container, class Stats>
+StaticThreadPool<Callable, Threads, Container, Stats>::StaticThreadPool(
+    const Affinity &affinity_,
+    std::function<void(std::exception_ptr)> on_error_):
+    m_is_finished(false),
+    m_is_stopping(false),
+    m_is_dropping(false),
+    m_affinity(affinity_),
+    m_on_error(std::move(on_error_)),
+    m_threads(),
+    m_pushing(0),
+    m_calls(),
+    m_actions(0),
+    m_stats(Threads)
+{
+    for (size_t i = 0; i < Threads; ++i)
+    {
+        m_threads[i] = std::thread(&StaticThreadPool::ThreadLoop, this, i);
+    }
+}
+
+template<class Callable, size_t Threads, class Container, class Stats>
+StaticThreadPool<Callable, Threads, Container, Stats>::~StaticThreadPool()
+{
+    // Finish working threads without completing all Callables.
+    Finish(false);
+}
+
+template<class Callable, size_t Threads, class Container, class Stats>
+inline bool StaticThreadPool<Callable, Threads, Container, Stats>::Push(
+    const Callable &call_)
+{
+    return Push(Callable(call_));
+}
+
+template<class Callable, size_t Threads, class Container, class Stats>
+inline bool StaticThreadPool<Callable, Threads, Container, Stats>::Push(
+    Callable &&call_)
+{
+    // Counted before the flag is read: either Finish waits for this push,
+    // or this push sees the flag.
+    PushScope scope(m_pushing);
+    if (m_is_finished) return false;
+
+    // Every Callable is queued before it's action is posted.
+    if (!m_calls.Push(Entry(std::move(call_)))) return false;
+
+    m_stats.OnPush(1);
+    m_actions.post();
+
+    return true;
+}
+
+template<class Callable, size_t Threads, class Container, class Stats>
+template<class Iterator>
+bool StaticThreadPool<Callable, Threads, Container, Stats>::PushBatch(
+    Iterator first_, Iterator last_)
+{
+    PushScope scope(m_pushing);
+    if (m_is_finished) return false;
+
+    size_t total = std::distance(first_, last_);
+    size_t count = m_calls.PushBatch(EntryIterator<Iterator>{first_},
+                                     EntryIterator<Iterator>{last_});
+
+    if (0 != count)
+    {
+        m_stats.OnPush(count);
+        m_actions.post(count);
+    }
+
+    return (count == total);
+}
+
+template<class Callable, size_t Threads, class Container, class Stats>
+template<class Range>
+inline bool StaticThreadPool<Callable, Threads, Container, Stats>::PushBatch(
+    Range &range_)
+{
+    return PushBatch(std::begin(range_), std::end(range_));
+}
+
+template<class Callable, size_t Threads, class Container, class Stats>
+template<class Func, class... Args>
+std::future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+StaticThreadPool<Callable, Threads, Container, Stats>::Submit(
+    Func &&func_, Args&&... args_)
+{
+    typedef std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>
+            Result;
+
+    std::promise<Result> promise;
+    std::future<Result> result(promise.get_future());
+
+    Callable call(details::MakeSubmitCall(std::move(promise),
+                                          std::forward<Func>(func_),
+                                          std::forward<Args>(args_)...));
+
+    if (!Push(std::move(call))) return std::future<Result>();
+
+    return result;
+}
+
+template<class Callable, size_t Threads, class Container, class Stats>
+bool StaticThreadPool<Callable, Threads, Container, Stats>::Finish(
+    bool let_complete_)
+{
+    if (m_is_finished.exchange(true)) return false;
+
+    // Every push that missed the flag has queued and posted it's Callable
+    // once the count is 0, so none is posted after the stop actions.
+    while (0 != m_pushing) std::this_thread::yield();
+
+    m_is_dropping = !let_complete_;
+    m_is_stopping = true;
+
+    // An action more than the Callables per thread, so every thread finds
+    // the queue empty once.
+    m_actions.post(Threads);
+
+    for (std::thread &thread : m_threads) thread.join();
+
+    return true;
+}
+
+template<class Callable, size_t Threads, class Container, class Stats>
+typename Stats::Snapshot
+StaticThreadPool<Callable, Threads, Container, Stats>::GetStats() const
+{
+    return m_stats.GetSnapshot();
+}
+
+template<class Callable, size_t Threads, class Container, class Stats>
+void StaticThreadPool<Callable, Threads, Container, Stats>::ThreadLoop(
+    size_t slot_)
+{
+    m_affinity.Apply(slot_);
+
+    while (1)
+    {
+        m_stats.OnIdleBegin(slot_);
+        m_actions.wait();
+        m_stats.OnIdleEnd(slot_);
+
+        if (m_is_dropping) break;
+
+        Entry call;
+
+        // Only the actions of Finish have no Callable, once no Push runs.
+        while (!m_calls.Pop(call))
+        {
+            if (m_is_stopping) return;
+            std::this_thread::yield();
+        }
+
+        details::RunEntry(m_stats, slot_, call, [this]()
+        {
+            details::PassError(m_on_error, std::current_exception());
+        });
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+#endif /* __DP_STATIC_THREAD_POOL_HPP__ */
@@ -0,0 +1,317 @@
+/* -------------------------------------------------------------------------- */
+/* task.hpp                                                                   */
+/* -------------------------------------------------------------------------- */
+
+#ifndef __DP_TASK_HPP__
+#define __DP_TASK_HPP__
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <cstddef>              // size_t, std::max_align_t
+#include <new>                  // placement new
+#include <type_traits>          // std::decay, std::enable_if
+#include <utility>              // std::forward, std::move
+
+#include <thread_pool/arena.hpp>
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Type-erased, move-only wrapper of any callable object with no
+ * arguments, to be used as the Callable of a ThreadPool. Callables that fit
+ * in INLINE_SIZE bytes and are nothrow-movable are stored inline, without
+ * a heap allocation. Larger ones are stored in a node of NodePool.
+ */
+class Task
+{
+public:
+    static const size_t INLINE_SIZE = 48;   // Size of the inline storage.
+
+    /**
+     * @brief Construct an empty Task object.
+     */
+    Task() noexcept;
+
+    /**
+     * @brief Construct a new Task object wrapping func_.
+     * @tparam F Callable type. Requires operator() with no arguments.
+     * @param func_ Callable object to wrap. It is moved or copied into
+     * the Task.
+     * @param priority_ Priority of the Task in the ThreadPool's queue. Higher
+     * runs first. 0 by default.
+     */
+    template<class F, class = typename std::enable_if<
+        !std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F &&func_, int priority_ = 0);
+
+    /**
+     * @brief Destroy the Task object and the wrapped callable.
+     */
+    ~Task();
+
+    // non-copyable
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    // movable
+    Task(Task &&other_) noexcept;
+    Task& operator=(Task &&other_) noexcept;
+
+    /**
+     * @brief Call the wrapped callable. The Task must not be empty.
+     */
+    void operator()();
+
+    /**
+     * @brief Return the Task's priority.
+     * @return int Priority given on construction.
+     */
+    int GetPriority() const noexcept;
+
+    /**
+     * @brief Check if the Task wraps a callable.
+     */
+    explicit operator bool() const noexcept;
+
+private:
+    /**
+     * @brief Operations on the wrapped callable, one table per type and
+     * storage kind.
+     */
+    struct Operations
+    {
+        void (*m_invoke)(void *storage_);
+        void (*m_move)(void *to_, void *from_) noexcept;
+        void (*m_destroy)(void *storage_) noexcept;
+    };
+
+    /**
+     * @brief Operations for a callable stored inline.
+     */
+    template<class F>
+    struct InlineOperations
+    {
+        static void Invoke(void *storage_);
+        static void Move(void *to_, void *from_) noexcept;
+        static void Destroy(void *storage_) noexcept;
+
+        static const Operations s_table;
+    };
+
+    /**
+     * @brief Operations for a callable stored in a NodePool node.
+     */
+    template<class F>
+    struct HeapOperations
+    {
+        static void Invoke(void *storage_);
+        static void Move(void *to_, void *from_) noexcept;
+        static void Destroy(void *storage_) noexcept;
+
+        static const Operations s_table;
+    };
+
+    /**
+     * @brief Check if a callable of type F is stored inline.
+     */
+    template<class F>
+    struct IsInline
+    {
+        static const bool value =
+            sizeof(F) <= INLINE_SIZE &&
+            alignof(std::max_align_t) % alignof(F) == 0 &&
+            std::is_nothrow_move_constructible<F>::value;
+    };
+
+    /**
+     * @brief Destroy the wrapped callable, leaving the Task empty.
+     */
+    void Reset() noexcept;
+
+    /* members -------------------------------------------------------------- */
+    alignas(std::max_align_t)
+    unsigned char       m_storage[INLINE_SIZE]; // Callable or pointer to it.
+    const Operations   *m_operations;           // nullptr if empty.
+    int                 m_priority;             // Queue priority.
+};
+
+/**
+ * @brief Order Tasks by their priority.
+ */
+inline bool operator<(const Task &lhs_, const Task &rhs_) noexcept
+{
+    return lhs_.GetPriority() < rhs_.GetPriority();
+}
+
+/* implementation ----------------------------------------------------------- */
+
+template<class F>
+const Task::Operations Task::InlineOperations<F>::s_table = {
+    &Task::InlineOperations<F>::Invoke,
+    &Task::InlineOperations<F>::Move,
+    &Task::InlineOperations<F>::Destroy
+};
+
+template<class F>
+void Task::InlineOperations<F>::Invoke(void *storage_)
+{
+    (*static_cast<F *>(storage_))();
+}
+
+template<class F>
+void Task::InlineOperations<F>::Move(void *to_, void *from_) noexcept
+{
+    new (to_) F(std::move(*static_cast<F *>(from_)));
+    static_cast<F *>(from_)->~F();
+}
+
+template<class F>
+void Task::InlineOperations<F>::Destroy(void *storage_) noexcept
+{
+    static_cast<F *>(storage_)->~F();
+}
+
+template<class F>
+const Task::Operations Task::HeapOperations<F>::s_table = {
+    &Task::HeapOperations<F>::Invoke,
+    &Task::HeapOperations<F>::Move,
+    &Task::HeapOperations<F>::Destroy
+};
+
+template<class F>
+void Task::HeapOperations<F>::Invoke(void *storage_)
+{
+    (**static_cast<F **>(storage_))();
+}
+
+template<class F>
+void Task::HeapOperations<F>::Move(void *to_, void *from_) noexcept
+{
+    // Only the pointer moves.
+    *static_cast<F **>(to_) = *static_cast<F **>(from_);
+}
+
+template<class F>
+void Task::HeapOperations<F>::Destroy(void *storage_) noexcept
+{
+    F *func = *static_cast<F **>(storage_);
+
+    if constexpr (alignof(F) <= alignof(std::max_align_t))
+    {
+        func->~F();
+        NodePool::Deallocate(func, sizeof(F));
+    }
+    else
+    {
+        delete func;
+    }
+}
+
+inline Task::Task() noexcept:
+    m_operations(nullptr),
+    m_priority(0)
+{
+    // Do nothing
+}
+
+template<class F, class>
+Task::Task(F &&func_, int priority_):
+    m_operations(nullptr),
+    m_priority(priority_)
+{
+    typedef typename std::decay<F>::type Func;
+
+    if constexpr (IsInline<Func>::value)
+    {
+        new (m_storage) Func(std::forward<F>(func_));
+        m_operations = &InlineOperations<Func>::s_table;
+    }
+    else if constexpr (alignof(Func) <= alignof(std::max_align_t))
+    {
+        void *node = NodePool::Allocate(sizeof(Func));
+
+        try
+        {
+            *reinterpret_cast<Func **>(m_storage) =
+                new (node) Func(std::forward<F>(func_));
+        }
+        catch (...)
+        {
+            NodePool::Deallocate(node, sizeof(Func));
+            throw;
+        }
+
+        m_operations = &HeapOperations<Func>::s_table;
+    }
+    else
+    {
+        // Over-aligned, NodePool nodes are not aligned enough.
+        *reinterpret_cast<Func **>(m_storage) =
+            new Func(std::forward<F>(func_));
+        m_operations = &HeapOperations<Func>::s_table;
+    }
+}
+
+inline Task::~Task()
+{
+    Reset();
+}
+
+inline Task::Task(Task &&other_) noexcept:
+    m_operations(other_.m_operations),
+    m_priority(other_.m_priority)
+{
+    if (m_operations)
+    {
+        m_operations->m_move(m_storage, other_.m_storage);
+        other_.m_operations = nullptr;
+    }
+}
+
+inline Task& Task::operator=(Task &&other_) noexcept
+{
+    if (this != &other_)
+    {
+        Reset();
+
+        m_operations = other_.m_operations;
+        m_priority = other_.m_priority;
+
+        if (m_operations)
+        {
+            m_operations->m_move(m_storage, other_.m_storage);
+            other_.m_operations = nullptr;
+        }
+    }
+
+    return *this;
+}
+
+inline void Task::operator()()
+{
+    m_operations->m_invoke(m_storage);
+}
+
+inline int Task::GetPriority() const noexcept
+{
+    return m_priority;
+}
+
+inline Task::operator bool() const noexcept
+{
+    return (nullptr != m_operations);
+}
+
+inline void Task::Reset() noexcept
+{
+    if (m_operations)
+    {
+        m_operations->m_destroy(m_storage);
+        m_operations = nullptr;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+#endif /* __DP_TASK_HPP__ */
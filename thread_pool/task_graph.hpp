@@ -0,0 +1,363 @@
+/* -------------------------------------------------------------------------- */
+/* task_graph.hpp                                                             */
+/* -------------------------------------------------------------------------- */
+
+#ifndef __DP_TASK_GRAPH_HPP__
+#define __DP_TASK_GRAPH_HPP__
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <atomic>               // std::atomic
+#include <cstddef>              // size_t
+#include <deque>                // std::deque
+#include <exception>            // std::exception_ptr
+#include <future>               // std::future_error
+#include <mutex>                // std::mutex, std::unique_lock
+#include <stdexcept>            // std::out_of_range, std::logic_error
+#include <utility>              // std::forward, std::exchange
+#include <vector>               // std::vector
+
+#include <thread_pool/task.hpp>
+#include <tools/semaphore/semaphore.hpp>
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Directed acyclic graph of Tasks executed on a ThreadPool<Task>.
+ * A node is pushed to the pool once all of it's predecessors are done. The
+ * worker finishing a node runs one ready successor inline and pushes the
+ * rest, so a chain of nodes never goes back through the pool's queue.
+ * If the pool drops a node instead of calling it - Finish(false), it's
+ * destructor, an overflow policy or a cancellation - the node and the nodes
+ * after it are skipped, and Wait throws std::future_error with
+ * broken_promise. A built graph can be run again without rebuilding it.
+ */
+class TaskGraph
+{
+public:
+    typedef size_t Node;
+
+    /**
+     * @brief Construct an empty Task Graph object.
+     */
+    TaskGraph();
+
+    // non-copyable
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    /**
+     * @brief Add a node to the graph. Not allowed while running.
+     * @tparam F Callable type. Requires operator() with no arguments. It is
+     * called once every Run. If it throws, the run still goes on, and Wait
+     * rethrows the first exception.
+     * @param func_ Callable object to execute.
+     * @return Node Id of the new node.
+     */
+    template<class F>
+    Node AddNode(F &&func_);
+
+    /**
+     * @brief Make after_ start only after before_ is done. Not allowed while
+     * running. The edges must not form a cycle.
+     * @param before_ Predecessor node.
+     * @param after_ Successor node.
+     */
+    void AddEdge(Node before_, Node after_);
+
+    /**
+     * @brief Start executing the graph on pool_. Returns without waiting.
+     * If pool_ refuses a node, the node is executed by the calling thread.
+     * @tparam Pool ThreadPool with Task as it's Callable.
+     * @param pool_ Thread Pool to execute on. Must outlive the run.
+     * @return bool False if the graph is already running.
+     */
+    template<class Pool>
+    bool Run(Pool &pool_);
+
+    /**
+     * @brief Block until the current run is done. Returns at once if the
+     * graph is not running. The graph may be destroyed once it returns.
+     * Rethrows the first exception thrown by a node during the run, once,
+     * or std::future_error with broken_promise if the pool dropped a node.
+     */
+    void Wait();
+
+    /**
+     * @brief Return the number of nodes in the graph.
+     */
+    size_t GetSize() const;
+
+private:
+    /**
+     * @brief Node's Task, it's successors and it's predecessor counters.
+     */
+    struct Vertex
+    {
+        explicit Vertex(Task &&work_): m_work(std::move(work_)) {}
+
+        Task                m_work;             // Callable of the node.
+        std::vector<Node>   m_successors;       // Nodes waiting for it.
+        size_t              m_predecessors = 0; // Number of nodes to wait for.
+        std::atomic<size_t> m_pending{0};       // Predecessors not done yet.
+        std::atomic<bool>   m_is_skipped{false};// A predecessor was dropped.
+    };
+
+    /**
+     * @brief Callable of a node pushed to a pool, executing it when called.
+     * If it is destroyed without being called, the node is dropped instead,
+     * so the run still ends.
+     */
+    template<class Pool>
+    class NodeCall
+    {
+    public:
+        NodeCall(TaskGraph *graph_, Pool *pool_, Node node_) noexcept:
+            m_graph(graph_),
+            m_pool(pool_),
+            m_node(node_)
+        {}
+
+        ~NodeCall()
+        {
+            if (m_graph) m_graph->Drop(*m_pool, m_node);
+        }
+
+        // non-copyable
+        NodeCall(const NodeCall&) = delete;
+        NodeCall& operator=(const NodeCall&) = delete;
+
+        // movable
+        NodeCall(NodeCall &&other_) noexcept:
+            m_graph(std::exchange(other_.m_graph, nullptr)),
+            m_pool(other_.m_pool),
+            m_node(other_.m_node)
+        {}
+
+        NodeCall& operator=(NodeCall &&) = delete;
+
+        void operator()()
+        {
+            std::exchange(m_graph, nullptr)->Execute(*m_pool, m_node);
+        }
+
+    private:
+        TaskGraph  *m_graph;            // Graph of the node, until used.
+        Pool       *m_pool;             // Pool the node was pushed to.
+        Node        m_node;             // Node to execute.
+    };
+
+    /**
+     * @brief Push node_ to pool_, or execute it here if it was refused.
+     */
+    template<class Pool>
+    void Schedule(Pool &pool_, Node node_);
+
+    /**
+     * @brief Execute node_, then the successors it made ready: one inline,
+     * the rest pushed to pool_.
+     */
+    template<class Pool>
+    void Execute(Pool &pool_, Node node_);
+
+    /**
+     * @brief Record a node dropped by pool_ as broken_promise, and skip it
+     * and the nodes after it.
+     */
+    template<class Pool>
+    void Drop(Pool &pool_, Node node_);
+
+    /* members -------------------------------------------------------------- */
+    std::deque<Vertex>  m_vertices;         // Nodes, never moved.
+    std::atomic<size_t> m_remaining;        // Nodes not done in current run.
+    Semaphore           m_done;             // Posted when a run is done.
+    std::exception_ptr  m_exception;        // First exception of the run.
+    std::mutex          m_lock;             // Lock for m_exception.
+};
+
+/* implementation ----------------------------------------------------------- */
+
+inline TaskGraph::TaskGraph():
+    m_vertices(),
+    m_remaining(0),
+    m_done(1),
+    m_exception(),
+    m_lock()
+{
+    // Do nothing
+}
+
+template<class F>
+TaskGraph::Node TaskGraph::AddNode(F &&func_)
+{
+    if (0 != m_remaining) throw(std::logic_error(
+        "TaskGraph can not change while running."
+    ));
+
+    m_vertices.emplace_back(Task(std::forward<F>(func_)));
+
+    return m_vertices.size() - 1;
+}
+
+inline void TaskGraph::AddEdge(Node before_, Node after_)
+{
+    if (0 != m_remaining) throw(std::logic_error(
+        "TaskGraph can not change while running."
+    ));
+    if (before_ >= GetSize() || after_ >= GetSize() || before_ == after_)
+    {
+        throw(std::out_of_range("TaskGraph edge between invalid nodes."));
+    }
+
+    m_vertices[before_].m_successors.push_back(after_);
+    ++m_vertices[after_].m_predecessors;
+}
+
+template<class Pool>
+bool TaskGraph::Run(Pool &pool_)
+{
+    if (m_vertices.empty()) return true;
+
+    // Take the done flag, only one run at a time.
+    if (!m_done.try_wait()) return false;
+
+    std::unique_lock<std::mutex> guard(m_lock);
+    m_exception = nullptr;
+    guard.unlock();
+
+    for (Vertex &vertex : m_vertices)
+    {
+        vertex.m_pending.store(vertex.m_predecessors,
+                               std::memory_order_relaxed);
+        vertex.m_is_skipped.store(false, std::memory_order_relaxed);
+    }
+    m_remaining.store(GetSize(), std::memory_order_release);
+
+    // Gather the roots first, a root may finish the whole run.
+    std::vector<Node> roots;
+    for (Node node = 0; node < GetSize(); ++node)
+    {
+        if (0 == m_vertices[node].m_predecessors) roots.push_back(node);
+    }
+
+    for (Node node : roots) Schedule(pool_, node);
+
+    return true;
+}
+
+inline void TaskGraph::Wait()
+{
+    m_done.wait();
+
+    std::unique_lock<std::mutex> guard(m_lock);
+    std::exception_ptr exception = m_exception;
+    m_exception = nullptr;
+    guard.unlock();
+
+    m_done.post();
+
+    if (exception) std::rethrow_exception(exception);
+}
+
+inline size_t TaskGraph::GetSize() const
+{
+    return m_vertices.size();
+}
+
+template<class Pool>
+void TaskGraph::Schedule(Pool &pool_, Node node_)
+{
+    Task task(NodeCall<Pool>(this, &pool_, node_));
+
+    // Refused, unless moved in and dropped: executed here.
+    if (!pool_.Push(std::move(task)) && task) task();
+}
+
+template<class Pool>
+void TaskGraph::Execute(Pool &pool_, Node node_)
+{
+    bool is_ready = true;
+
+    while (is_ready)
+    {
+        Vertex &vertex = m_vertices[node_];
+        bool is_skipped = vertex.m_is_skipped.load(std::memory_order_relaxed);
+
+        try
+        {
+            if (!is_skipped) vertex.m_work();
+        }
+        catch (...)
+        {
+            std::unique_lock<std::mutex> guard(m_lock);
+            if (!m_exception) m_exception = std::current_exception();
+        }
+
+        is_ready = false;
+        Node next = 0;
+
+        for (Node successor : vertex.m_successors)
+        {
+            Vertex &after = m_vertices[successor];
+
+            // Marked before the count, seen by the one taking it to 0.
+            if (is_skipped)
+            {
+                after.m_is_skipped.store(true, std::memory_order_relaxed);
+            }
+
+            if (1 != after.m_pending.fetch_sub(1, std::memory_order_acq_rel))
+            {
+                continue;
+            }
+
+            // Keep the first ready successor for this thread. Skipped ones
+            // are done here too, they never go back to the pool.
+            if (!is_ready)
+            {
+                is_ready = true;
+                next = successor;
+            }
+            else if (after.m_is_skipped.load(std::memory_order_relaxed))
+            {
+                Execute(pool_, successor);
+            }
+            else
+            {
+                Schedule(pool_, successor);
+            }
+        }
+
+        // The last node made no successor ready. Wait may return and the
+        // graph be destroyed once the post is published, this is the last
+        // access to it: Semaphore::post does not touch it's object after.
+        if (1 == m_remaining.fetch_sub(1, std::memory_order_acq_rel))
+        {
+            m_done.post();
+            return;
+        }
+
+        node_ = next;
+    }
+}
+
+template<class Pool>
+void TaskGraph::Drop(Pool &pool_, Node node_)
+{
+    {
+        std::unique_lock<std::mutex> guard(m_lock);
+        if (!m_exception)
+        {
+            m_exception = std::make_exception_ptr(
+                std::future_error(std::future_errc::broken_promise));
+        }
+    }
+
+    m_vertices[node_].m_is_skipped.store(true, std::memory_order_relaxed);
+    Execute(pool_, node_);
+}
+
+/* -------------------------------------------------------------------------- */
+#endif /* __DP_TASK_GRAPH_HPP__ */
@@ -0,0 +1,554 @@
+/* -------------------------------------------------------------------------- */
+/* task_queue.hpp                                                             */
+/* -------------------------------------------------------------------------- */
+
+#ifndef __DP_TASK_QUEUE_HPP__
+#define __DP_TASK_QUEUE_HPP__
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <algorithm>            // std::push_heap, std::pop_heap, std::min
+#include <atomic>               // std::atomic
+#include <cstddef>              // size_t
+#include <cstdint>              // uint64_t
+#include <deque>                // std::deque
+#include <mutex>                // std::mutex, std::unique_lock
+#include <new>                  // placement new
+#include <utility>              // std::move
+#include <vector>               // std::vector
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Containers of Callable objects for the ThreadPool. A container must be
+ * safe to use from multiple threads and provide:
+ *  Rebind<T>                       - Same container, holding T instead.
+ *  bool Push(Callable &&call_)     - Add a Callable, false if full.
+ *  size_t PushBatch(first_, last_) - Move in a batch, return number added.
+ *  bool Pop(Callable &call_)       - Take a Callable, false if none found.
+ *  size_t Size() const             - Number of Callables held.
+ */
+
+/* -------------------------------------------------------------------------- */
+/* priority queue                                                             */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Unbounded queue ordered by the Callable's operator<, guarded by a
+ * single lock.
+ * @tparam Callable Class to hold. Requires operator<.
+ */
+template<class Callable>
+class PriorityQueue
+{
+public:
+    template<class T>
+    using Rebind = PriorityQueue<T>;
+
+    /**
+     * @brief Construct an empty Priority Queue object.
+     */
+    PriorityQueue() = default;
+
+    // non-copyable
+    PriorityQueue(const PriorityQueue&) = delete;
+    PriorityQueue& operator=(const PriorityQueue&) = delete;
+
+    /**
+     * @brief Add a Callable object to the queue.
+     * @param call_ Callable object to move in.
+     * @return bool Always true.
+     */
+    bool Push(Callable &&call_);
+
+    /**
+     * @brief Move a batch of Callable objects in, under a single lock.
+     * @param first_ Beginning of the batch.
+     * @param last_ End of the batch.
+     * @return size_t Number of Callable objects added.
+     */
+    template<class Iterator>
+    size_t PushBatch(Iterator first_, Iterator last_);
+
+    /**
+     * @brief Take the highest Callable object out of the queue.
+     * @param call_ Output Callable object.
+     * @return bool Was the queue not empty.
+     */
+    bool Pop(Callable &call_);
+
+    /**
+     * @brief Return the number of Callable objects in the queue.
+     */
+    size_t Size() const;
+
+private:
+    /* members -------------------------------------------------------------- */
+    std::vector<Callable>   m_calls;    // Callable objects heap.
+    mutable std::mutex      m_lock;     // Lock for the queue's actions.
+};
+
+/* -------------------------------------------------------------------------- */
+/* band queue                                                                 */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Unbounded queue of a fixed number of priority bands, with a FIFO
+ * per band, guarded by a single lock. A bitmap of the non-empty bands finds
+ * the highest one, so Push and Pop are O(1). Against starvation, every
+ * Aging-th Pop serves a lower non-empty band instead, going down the bands
+ * in turn. Callable's operator< is ignored.
+ * @tparam Callable Class to hold. Requires int GetPriority() const, such as
+ * Task. The priority is the band, clamped to [0, Bands). Higher runs first.
+ * @tparam Bands Number of bands, up to 64.
+ * @tparam Aging Pops between serving a lower band. 0 for strict priority.
+ */
+template<class Callable, size_t Bands = 3, size_t Aging = 16>
+class BandQueue
+{
+    static_assert(0 < Bands && Bands <= 64,
+                  "BandQueue Bands must be between 1 and 64.");
+
+public:
+    template<class T>
+    using Rebind = BandQueue<T, Bands, Aging>;
+
+    /**
+     * @brief Construct an empty Band Queue object.
+     */
+    BandQueue();
+
+    // non-copyable
+    BandQueue(const BandQueue&) = delete;
+    BandQueue& operator=(const BandQueue&) = delete;
+
+    /**
+     * @brief Add a Callable object to the back of it's band.
+     * @param call_ Callable object to move in.
+     * @return bool Always true.
+     */
+    bool Push(Callable &&call_);
+
+    /**
+     * @brief Move a batch of Callable objects in, under a single lock.
+     * @param first_ Beginning of the batch.
+     * @param last_ End of the batch.
+     * @return size_t Number of Callable objects added.
+     */
+    template<class Iterator>
+    size_t PushBatch(Iterator first_, Iterator last_);
+
+    /**
+     * @brief Take the oldest Callable object of the highest non-empty band,
+     * or of a lower band when it is it's turn to age.
+     * @param call_ Output Callable object.
+     * @return bool Was the queue not empty.
+     */
+    bool Pop(Callable &call_);
+
+    /**
+     * @brief Return the number of Callable objects in the queue.
+     */
+    size_t Size() const;
+
+private:
+    /**
+     * @brief Return the band of call_.
+     */
+    static size_t BandOf(const Callable &call_);
+
+    /**
+     * @brief Return the highest band set in bitmap_, which is not 0.
+     */
+    static size_t Highest(uint64_t bitmap_);
+
+    /**
+     * @brief Add call_ to it's band. Requires m_lock.
+     */
+    void Add(Callable &&call_);
+
+    /* members -------------------------------------------------------------- */
+    std::deque<Callable>    m_bands[Bands]; // FIFO of every band.
+    uint64_t                m_bitmap;       // Bit per non-empty band.
+    size_t                  m_size;         // Number of Callables held.
+    size_t                  m_pops;         // Pops since the last aging.
+    size_t                  m_aged;         // Band aged last.
+    mutable std::mutex      m_lock;         // Lock for the queue's actions.
+};
+
+/* -------------------------------------------------------------------------- */
+/* bounded queue                                                              */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Lock-free, bounded, multi-producer multi-consumer FIFO queue,
+ * based on Dmitry Vyukov's ring buffer. Every cell and both indexes are on
+ * their own cache line. Callable's operator< is ignored.
+ * @tparam Callable Class to hold. Requires nothrow move.
+ * @tparam Capacity Maximum number of Callables held. Must be a power of 2.
+ */
+template<class Callable, size_t Capacity = 1024>
+class BoundedQueue
+{
+    static_assert(0 < Capacity && 0 == (Capacity & (Capacity - 1)),
+                  "BoundedQueue Capacity must be a power of 2.");
+
+public:
+    static const size_t CACHE_LINE = 64;
+
+    template<class T>
+    using Rebind = BoundedQueue<T, Capacity>;
+
+    /**
+     * @brief Construct an empty Bounded Queue object.
+     */
+    BoundedQueue();
+
+    /**
+     * @brief Destroy the Bounded Queue object and the Callables left in it.
+     */
+    ~BoundedQueue();
+
+    // non-copyable
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /**
+     * @brief Add a Callable object to the queue.
+     * @param call_ Callable object to move in.
+     * @return bool False if the queue is full.
+     */
+    bool Push(Callable &&call_);
+
+    /**
+     * @brief Move a batch of Callable objects in. Stops at the first one
+     * that does not fit.
+     * @param first_ Beginning of the batch.
+     * @param last_ End of the batch.
+     * @return size_t Number of Callable objects added.
+     */
+    template<class Iterator>
+    size_t PushBatch(Iterator first_, Iterator last_);
+
+    /**
+     * @brief Take the oldest Callable object out of the queue.
+     * @param call_ Output Callable object.
+     * @return bool False if the queue is empty, or the oldest Callable is
+     * still being added.
+     */
+    bool Pop(Callable &call_);
+
+    /**
+     * @brief Return the approximate number of Callable objects in the queue.
+     */
+    size_t Size() const;
+
+private:
+    /**
+     * @brief Ring buffer cell. m_sequence tells which lap the cell is
+     * ready for: equal to the position when free, position + 1 when full.
+     */
+    struct alignas(CACHE_LINE) Cell
+    {
+        std::atomic<size_t> m_sequence;
+        alignas(Callable) unsigned char m_storage[sizeof(Callable)];
+    };
+
+    /**
+     * @brief Index padded to a cache line of it's own.
+     */
+    struct alignas(CACHE_LINE) Index
+    {
+        std::atomic<size_t> m_value;
+    };
+
+    static Callable *At(Cell &cell_);
+
+    /* members -------------------------------------------------------------- */
+    Cell    m_cells[Capacity];  // Ring buffer.
+    Index   m_push;             // Next position to push to.
+    Index   m_pop;              // Next position to pop from.
+};
+
+/* implementation ----------------------------------------------------------- */
+
+template<class Callable>
+bool PriorityQueue<Callable>::Push(Callable &&call_)
+{
+    std::unique_lock<std::mutex> guard(m_lock); // Critical section start.
+
+    m_calls.push_back(std::move(call_));
+    std::push_heap(m_calls.begin(), m_calls.end());
+
+    return true;
+}                                               // Critical section end.
+
+template<class Callable>
+template<class Iterator>
+size_t PriorityQueue<Callable>::PushBatch(Iterator first_, Iterator last_)
+{
+    size_t count = 0;
+
+    std::unique_lock<std::mutex> guard(m_lock); // Critical section start.
+
+    for (; first_ != last_; ++first_, ++count)
+    {
+        m_calls.push_back(std::move(*first_));
+        std::push_heap(m_calls.begin(), m_calls.end());
+    }
+
+    return count;
+}                                               // Critical section end.
+
+template<class Callable>
+bool PriorityQueue<Callable>::Pop(Callable &call_)
+{
+    std::unique_lock<std::mutex> guard(m_lock); // Critical section start.
+
+    if (m_calls.empty()) return false;
+
+    std::pop_heap(m_calls.begin(), m_calls.end());
+    call_ = std::move(m_calls.back());
+    m_calls.pop_back();
+
+    return true;
+}                                               // Critical section end.
+
+template<class Callable>
+size_t PriorityQueue<Callable>::Size() const
+{
+    std::unique_lock<std::mutex> guard(m_lock); // Critical section start.
+
+    return m_calls.size();
+}                                               // Critical section end.
+
+/* -------------------------------------------------------------------------- */
+
+template<class Callable, size_t Bands, size_t Aging>
+BandQueue<Callable, Bands, Aging>::BandQueue():
+    m_bands(),
+    m_bitmap(0),
+    m_size(0),
+    m_pops(0),
+    m_aged(0),
+    m_lock()
+{
+    // Do nothing
+}
+
+template<class Callable, size_t Bands, size_t Aging>
+bool BandQueue<Callable, Bands, Aging>::Push(Callable &&call_)
+{
+    std::unique_lock<std::mutex> guard(m_lock); // Critical section start.
+
+    Add(std::move(call_));
+
+    return true;
+}                                               // Critical section end.
+
+template<class Callable, size_t Bands, size_t Aging>
+template<class Iterator>
+size_t BandQueue<Callable, Bands, Aging>::PushBatch(Iterator first_,
+                                                    Iterator last_)
+{
+    size_t count = 0;
+
+    std::unique_lock<std::mutex> guard(m_lock); // Critical section start.
+
+    for (; first_ != last_; ++first_, ++count) Add(std::move(*first_));
+
+    return count;
+}                                               // Critical section end.
+
+template<class Callable, size_t Bands, size_t Aging>
+bool BandQueue<Callable, Bands, Aging>::Pop(Callable &call_)
+{
+    std::unique_lock<std::mutex> guard(m_lock); // Critical section start.
+
+    if (0 == m_bitmap) return false;
+
+    size_t band = Highest(m_bitmap);
+
+    // Aging turn: the next non-empty band below the one aged last, wrapping
+    // around to the highest band below the top.
+    if (0 != Aging && Aging == ++m_pops)
+    {
+        m_pops = 0;
+
+        uint64_t lower = m_bitmap & ((uint64_t(1) << band) - 1);
+        uint64_t next = lower & ((uint64_t(1) << m_aged) - 1);
+
+        if (0 != next) lower = next;
+        if (0 != lower) band = m_aged = Highest(lower);
+    }
+
+    std::deque<Callable> &calls = m_bands[band];
+    call_ = std::move(calls.front());
+    calls.pop_front();
+
+    if (calls.empty()) m_bitmap &= ~(uint64_t(1) << band);
+    --m_size;
+
+    return true;
+}                                               // Critical section end.
+
+template<class Callable, size_t Bands, size_t Aging>
+size_t BandQueue<Callable, Bands, Aging>::Size() const
+{
+    std::unique_lock<std::mutex> guard(m_lock); // Critical section start.
+
+    return m_size;
+}                                               // Critical section end.
+
+template<class Callable, size_t Bands, size_t Aging>
+size_t BandQueue<Callable, Bands, Aging>::BandOf(const Callable &call_)
+{
+    int priority = call_.GetPriority();
+
+    if (0 > priority) return 0;
+
+    return std::min(static_cast<size_t>(priority), Bands - 1);
+}
+
+template<class Callable, size_t Bands, size_t Aging>
+size_t BandQueue<Callable, Bands, Aging>::Highest(uint64_t bitmap_)
+{
+    return 63 - __builtin_clzll(bitmap_);
+}
+
+template<class Callable, size_t Bands, size_t Aging>
+void BandQueue<Callable, Bands, Aging>::Add(Callable &&call_)
+{
+    size_t band = BandOf(call_);
+
+    m_bands[band].push_back(std::move(call_));
+    m_bitmap |= (uint64_t(1) << band);
+    ++m_size;
+}
+
+/* -------------------------------------------------------------------------- */
+
+template<class Callable, size_t Capacity>
+BoundedQueue<Callable, Capacity>::BoundedQueue()
+{
+    for (size_t i = 0; i < Capacity; ++i)
+    {
+        m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+    }
+
+    m_push.m_value.store(0, std::memory_order_relaxed);
+    m_pop.m_value.store(0, std::memory_order_relaxed);
+}
+
+template<class Callable, size_t Capacity>
+BoundedQueue<Callable, Capacity>::~BoundedQueue()
+{
+    Callable left;
+    while (Pop(left)) {}
+}
+
+template<class Callable, size_t Capacity>
+bool BoundedQueue<Callable, Capacity>::Push(Callable &&call_)
+{
+    size_t position = m_push.m_value.load(std::memory_order_relaxed);
+
+    while (1)
+    {
+        Cell &cell = m_cells[position & (Capacity - 1)];
+        size_t sequence = cell.m_sequence.load(std::memory_order_acquire);
+        long diff = static_cast<long>(sequence) - static_cast<long>(position);
+
+        if (0 == diff)
+        {
+            // Cell is free, claim it.
+            if (m_push.m_value.compare_exchange_weak(position, position + 1,
+                                                     std::memory_order_relaxed))
+            {
+                new (cell.m_storage) Callable(std::move(call_));
+                cell.m_sequence.store(position + 1, std::memory_order_release);
+
+                return true;
+            }
+        }
+        else if (0 > diff)
+        {
+            // Cell still holds a Callable from the previous lap.
+            return false;
+        }
+        else
+        {
+            position = m_push.m_value.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template<class Callable, size_t Capacity>
+template<class Iterator>
+size_t BoundedQueue<Callable, Capacity>::PushBatch(Iterator first_,
+                                                   Iterator last_)
+{
+    size_t count = 0;
+
+    for (; first_ != last_ && Push(std::move(*first_)); ++first_, ++count) {}
+
+    return count;
+}
+
+template<class Callable, size_t Capacity>
+bool BoundedQueue<Callable, Capacity>::Pop(Callable &call_)
+{
+    size_t position = m_pop.m_value.load(std::memory_order_relaxed);
+
+    while (1)
+    {
+        Cell &cell = m_cells[position & (Capacity - 1)];
+        size_t sequence = cell.m_sequence.load(std::memory_order_acquire);
+        long diff = static_cast<long>(sequence) -
+                    static_cast<long>(position + 1);
+
+        if (0 == diff)
+        {
+            // Cell is full, claim it.
+            if (m_pop.m_value.compare_exchange_weak(position, position + 1,
+                                                    std::memory_order_relaxed))
+            {
+                Callable *stored = At(cell);
+                call_ = std::move(*stored);
+                stored->~Callable();
+                cell.m_sequence.store(position + Capacity,
+                                      std::memory_order_release);
+
+                return true;
+            }
+        }
+        else if (0 > diff)
+        {
+            // Cell was not pushed to yet.
+            return false;
+        }
+        else
+        {
+            position = m_pop.m_value.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template<class Callable, size_t Capacity>
+size_t BoundedQueue<Callable, Capacity>::Size() const
+{
+    size_t pop = m_pop.m_value.load(std::memory_order_relaxed);
+    size_t push = m_push.m_value.load(std::memory_order_relaxed);
+
+    return (push > pop) ? push - pop : 0;
+}
+
+template<class Callable, size_t Capacity>
+Callable *BoundedQueue<Callable, Capacity>::At(Cell &cell_)
+{
+    return std::launder(reinterpret_cast<Callable *>(cell_.m_storage));
+}
+
+/* -------------------------------------------------------------------------- */
+#endif /* __DP_TASK_QUEUE_HPP__ */
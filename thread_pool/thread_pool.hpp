@@ -9,28 +9,61 @@
 /* include libraries                                                          */
 /* -------------------------------------------------------------------------- */
 
+#include <algorithm>            // std::max
+#include <atomic>               // std::atomic
+#include <chrono>               // std::chrono::nanoseconds
 #include <condition_variable>   // std::condition_variable
+#include <deque>                // std::deque
+#include <exception>            // std::exception_ptr
+#include <functional>           // std::function
+#include <future>               // std::future, std::promise
+#include <memory>               // std::shared_ptr, std::make_shared
+#include <iterator>             // std::begin, std::end, std::distance
 #include <mutex>                // std::mutex, std::unique_lock
 #include <stdexcept>            // std::length_error
 #include <thread>               // std::thread
-#include <unordered_map>        // std::unordered_map
-#include <queue>                // std::priority_queue, std::queue
-
+#include <type_traits>          // std::invoke_result
+#include <vector>               // std::vector
+
+#include <thread_pool/arena.hpp>
+#include <thread_pool/cancel_token.hpp>
+#include <thread_pool/pool_call.hpp>
+#include <thread_pool/pool_stats.hpp>
+#include <thread_pool/task.hpp>
+#include <thread_pool/task_queue.hpp>
+#include <thread_pool/timer_wheel.hpp>
+#include <tools/affinity/affinity.hpp>
 #include <tools/semaphore/semaphore.hpp>
 
 /* -------------------------------------------------------------------------- */
 /* import symbols                                                             */
 /* -------------------------------------------------------------------------- */
 
+using std::atomic;
 using std::condition_variable;
+using std::deque;
+using std::future;
 using std::move;
 using std::mutex;
 using std::length_error;
 using std::unique_lock;
 using std::thread;
-using std::unordered_map;
-using std::priority_queue;
-using std::queue;
+using std::vector;
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Counters of the pushes that found a ThreadPool's queue full, see
+ * ThreadPool::SetCapacity.
+ */
+struct OverflowStats
+{
+    size_t      m_blocked;              // Pushes that waited for space.
+    size_t      m_rejected;             // Pushes refused.
+    size_t      m_dropped;              // Queued Callables dropped for space.
+    size_t      m_inlined;              // Callables run by the pushing thread.
+    size_t      m_timer_drops;          // Timer runs dropped, queue full.
+};
 
 /* -------------------------------------------------------------------------- */
 
@@ -38,20 +71,65 @@ using std::queue;
  * @brief Managing object of set number of threads for execution of Callable
  * objects without the need to constantly create and destroy threads.
  * @tparam Callable Class to execute. Requires operator() with no arguments,
- * and operator<. Also, Callable need to be movable/copyable.
+ * and operator<. Also, Callable need to be default constructible and
+ * movable/copyable. Use Task to execute any callable object, and to Submit
+ * calls with a result.
+ * @tparam Container Queue of Callable objects used in PRIORITY mode, see
+ * task_queue.hpp. PriorityQueue by default, BoundedQueue for a lock-free FIFO
+ * with a fixed capacity, BandQueue for FIFO priority bands.
+ * @tparam Stats Statistics policy, see pool_stats.hpp. NoStats by default,
+ * which records nothing and costs nothing. PoolStats for GetStats(), or
+ * PoolTrace in pool_trace.hpp for a timeline of the Callables.
+ * A running Callable can allocate scratch memory from it's thread's Arena,
+ * see Arena::Current(). The arena is reset once the Callable returns.
  */
-template<class Callable>
+template<class Callable, class Container = PriorityQueue<Callable>,
+         class Stats = NoStats>
 class ThreadPool
 {
     enum Status { RUNNING, PAUSED, FINISHED };
 
+    // Type stored in the queues for every Callable.
+    typedef typename Stats::template Entry<Callable> Entry;
+
 public:
+    /**
+     * @brief Way the Callable objects are distributed between threads.
+     * PRIORITY - A single shared Container, ordered by Callable's operator<
+     * unless the Container is a FIFO.
+     * STEALING - A queue per thread. Threads execute their own Callables
+     * first (newest first) and steal the oldest ones from other threads when
+     * empty. Callable's operator< is ignored.
+     */
+    enum Scheduling { PRIORITY, STEALING };
+
+    /**
+     * @brief What a Push does when the queued Callables reach the capacity.
+     * BLOCK       - Wait for a thread to take a Callable. A Push from one of
+     *               the Thread Pool's own threads runs the Callable inline
+     *               instead, so the threads never wait on each other.
+     * REJECT      - Refuse the Callable, Push returns false.
+     * DROP_OLDEST - Drop the queued Callable that would run next, the oldest
+     *               one in a FIFO Container, to make space.
+     * RUN_INLINE  - Run the Callable on the pushing thread. It's exceptions
+     *               reach the caller.
+     */
+    enum Overflow { BLOCK, REJECT, DROP_OLDEST, RUN_INLINE };
+
     /**
      * @brief Construct a new Thread Pool object.
      * @param threads_num_ Number of starting threads. By default, it is the
      * maximum number of threads available, and can not excide this value.
+     * @param scheduling_ Scheduling mode of the Thread Pool. PRIORITY by
+     * default.
+     * @param affinity_ Placement of the threads on CPUs, by their slot. No
+     * placement by default. In STEALING mode, Callables pushed from outside
+     * the Thread Pool go to a queue of a thread on the pushing thread's NUMA
+     * node, and threads steal from their own node first.
      */
-    explicit ThreadPool(size_t threads_num_ = THREAD_MAX);
+    explicit ThreadPool(size_t threads_num_ = THREAD_MAX,
+                        Scheduling scheduling_ = PRIORITY,
+                        const Affinity &affinity_ = Affinity());
 
     /**
      * @brief Destroy the Thread Pool object. 
@@ -64,11 +142,23 @@ public:
 
     /**
      * @brief Pause the Thread Pool's threads from executing untill
-     * Continue is called.
-     * @return bool Did the action succeed.
+     * Continue is called. Blocks until the running Callables end.
+     * @return bool Did the action succeed. False if finished, or if the pause
+     * was cancelled by Continue before it was complete.
      */
     bool Pause();
 
+    /**
+     * @brief Pause the Thread Pool without waiting for the running Callables.
+     * No Callable starts from the call on, and on_paused_ is called once the
+     * running ones end - by the last thread to end one, or by the calling
+     * thread if none is running.
+     * @param on_paused_ Called once paused. Also called if Continue cancels
+     * the pause before it is complete. Must not block.
+     * @return bool Did the action succeed. False if finished.
+     */
+    bool PauseAsync(std::function<void()> on_paused_);
+
     /**
      * @brief Resume the Thread Pool's threads after call of Pause().
      * @return bool Did the action succeed.
@@ -76,294 +166,2250 @@ public:
     bool Continue();
 
     /**
-     * @brief End the Thread Pool and it's threads.
+     * @brief End the Thread Pool and it's threads. Blocks until the threads
+     * end, also after FinishAsync.
      * @param let_complete_ Should the Thread Pool let all the Callable objects
      * left to be executed.
-     * @return bool Did the action succeed.
+     * @return bool Did the action succeed. False if already finished.
      */
     bool Finish(bool let_complete_ = true);
 
+    /**
+     * @brief End the Thread Pool without waiting for it's threads. Push is
+     * refused from the call on, and on_finished_ is called by the last thread
+     * to end. The threads are joined by Finish or by the destructor.
+     * @param on_finished_ Called once all the threads ended. Must not block.
+     * @param let_complete_ Should the Thread Pool let all the Callable objects
+     * left to be executed.
+     * @return bool Did the action succeed. False if already finished.
+     */
+    bool FinishAsync(std::function<void()> on_finished_,
+                     bool let_complete_ = true);
+
+    /**
+     * @brief Block until every Callable pushed before the call is done.
+     * Callables pushed meanwhile are not waited for. Waits until Continue
+     * while paused, and returns once finishing discards the Callables left.
+     * Must not be called from a Callable of the Thread Pool.
+     */
+    void Drain();
+
     /**
      * @brief Set the number of working threads.
      * 
      * @param nthread_ New number of working threads. By default, it is the
      * maximum number of threads available, and can not excide this value.
-     * @return bool Did the action succeed.
+     * @return bool Did the action succeed. False if paused or finished.
      */
     bool SetNumOfThreads(size_t nthread_ = THREAD_MAX);
 
+    /**
+     * @brief Let the Thread Pool change it's number of threads by itself.
+     * A thread is added on Push when no thread was idle for wait_target_,
+     * and an idle thread retires by itself after idle_timeout_. Neither
+     * blocks on other threads.
+     * @param min_ Minimum number of threads. Idle threads do not retire below.
+     * @param max_ Maximum number of threads, can not excide THREAD_MAX.
+     * @param wait_target_ Longest time Callables should wait for a thread.
+     * @param idle_timeout_ Time a thread waits for action before retiring.
+     * @return bool Did the action succeed. False if finished.
+     */
+    bool SetAutoScale(size_t min_, size_t max_,
+                      std::chrono::nanoseconds wait_target_,
+                      std::chrono::nanoseconds idle_timeout_);
+
+    /**
+     * @brief Stop changing the number of threads automatically.
+     */
+    void StopAutoScale();
+
+    /**
+     * @brief Set how idle threads wait for a Callable: spin for spin_, then
+     * yield the CPU for yield_, and only then park. A Push does not wake a
+     * parked thread while a thread spins or yields, the one taking it wakes
+     * the next if more Callables are left. Trades CPU time for the latency
+     * of short Callables. Both 0, parking at once, by default.
+     * @param spin_ Time to spin for.
+     * @param yield_ Time to yield for, after spinning.
+     */
+    void SetIdlePolicy(std::chrono::microseconds spin_,
+                       std::chrono::microseconds yield_ =
+                           std::chrono::microseconds::zero());
+
+    /**
+     * @brief Set the number of Callables queued per thread from which Spawn
+     * runs Callables inline. 2 by default.
+     * @param limit_ Queued Callables per thread, 0 to always run inline.
+     */
+    void SetSpawnLimit(size_t limit_);
+
+    /**
+     * @brief Limit the number of Callables queued and not taken by a thread
+     * yet. Push, Emplace, Submit and the timers follow overflow_ once the
+     * limit is reached; PushBatch never blocks and refuses the Callables
+     * beyond it. Unbounded by default.
+     * @param capacity_ Maximum number of queued Callables, 0 for no limit.
+     * @param overflow_ Policy of a Push to a full queue. BLOCK by default.
+     * @return bool Did the action succeed. False if finished.
+     */
+    bool SetCapacity(size_t capacity_, Overflow overflow_ = BLOCK);
+
+    /**
+     * @brief Set the callback for exceptions thrown by Callables. The thread
+     * that caught the exception calls it, and then goes on with the next
+     * Callable. Exceptions are dropped while there is no callback. Submit
+     * results get their exception through the future instead.
+     * @param on_error_ Called with the exception. Exceptions it throws are
+     * dropped.
+     */
+    void SetErrorHandler(std::function<void(std::exception_ptr)> on_error_);
+
     /**
      * @brief Add new Callable object to the Thread Pool for
-     * it's threads to execute.
-     * @param call_ Callable object to execute.
-     * @return bool Did the action succeed.
+     * it's threads to execute. In STEALING mode, a Callable pushed from one of
+     * the Thread Pool's threads is added to that thread's own queue, otherwise
+     * the queues are chosen round-robin.
+     * @param call_ Callable object to execute. It is copied.
+     * @return bool Did the action succeed. False if finished, or if the
+     * Container is full.
      */
     bool Push(Callable &call_);
 
     /**
-     * @brief Shutdown the Thread Pool and it's threads. This action will block
-     * untill all working threads have finished and closed themself.
-     * @param complete_calls_ Should this action wait for all calls to end.
-     * true by default.Semaphore m_
-     * @brief Return the number of working threads.
-     * @return size_t Number of working threads.
+     * @brief Add new Callable object to the Thread Pool, moving it in. Allows
+     * move-only Callables.
+     * @param call_ Callable object to execute. It is moved from.
+     * @return bool Did the action succeed. False if finished, or if the
+     * Container is full.
      */
-    size_t GetSize() const;
-    
-private:
-    static const size_t THREAD_MAX;
+    bool Push(Callable &&call_);
 
     /**
-     * @brief Return the first Callable object from Thread Pool.
-     * @return Callable Object to execute.
+     * @brief Add a Callable object to the Thread Pool with a cancellation
+     * token. Once token_ is cancelled, the Callable is dropped instead of
+     * called if still queued, without searching the queue - the thread that
+     * pops it only destroys it. A running Callable polls
+     * CancelToken::Current().
+     * @param call_ Callable object to execute. It is moved from.
+     * @param token_ Token to cancel the Callable with.
+     * @return bool Did the action succeed. False if finished, if the
+     * Container is full, or if token_ is cancelled already.
      */
-    Callable Pop();
+    bool Push(Callable &&call_, CancelToken token_);
 
     /**
-     * @brief Main loop for threads to run, get Callable object and execute it.
+     * @brief Same as Push, but refuses the Callable when the queue is at the
+     * capacity, whatever the Overflow policy.
+     * @param call_ Callable object to execute. It is moved from.
+     * @return bool Did the action succeed. False if finished, or if full.
      */
-    void ThreadLoop();
+    bool TryPush(Callable &&call_);
 
     /**
-     * @brief Add new threads to Thread pool.
-     * @param nthread_ Number of threads to add.
+     * @brief Push for nested parallelism. Called from one of the Thread
+     * Pool's threads, runs call_ inline once the calling thread has
+     * SetSpawnLimit Callables queued or more - in STEALING mode in it's own
+     * queue, in PRIORITY mode per thread on average - and pushes it
+     * otherwise, to it's own queue in STEALING mode. So a recursive split
+     * queues enough work to keep the threads busy, and runs the rest
+     * without a handoff. Called from any other thread, same as Push.
+     * @param call_ Callable object to execute. It is moved from. It's
+     * exceptions reach the caller when run inline.
+     * @return bool Did the action succeed. False if finished, or if the
+     * Container is full.
      */
-    void AddThreads(size_t nthread_);
+    bool Spawn(Callable &&call_);
 
     /**
-     * @brief Remove threads from Thread pool.
-     * @param nthread_ Number of threads to remove.
+     * @brief Construct a Callable object from args_ and add it to the Thread
+     * Pool. The Callable is constructed once, and only moved afterwards.
+     * @tparam Args Types of the Callable's constructor arguments.
+     * @param args_ Arguments to construct the Callable with.
+     * @return bool Did the action succeed. False if finished, or if the
+     * Container is full.
      */
-    void RemoveThreads(size_t nthread_);
+    template<class... Args>
+    bool Emplace(Args&&... args_);
 
-    /* members -------------------------------------------------------------- */
-    Status          m_status;           // Thread Pool run status.
-    unordered_map<thread::id, thread>   // Working threads.
-                    m_threads;      
-    priority_queue<Callable>            // Callable objects queue.
-                    m_calls;
-    mutex           m_calls_lock;       // Lock for the queue's actions.
-    queue<thread::id>                   // Queue of threads to remove.
-                    m_to_remove;
-    mutex           m_remove_lock;      // Lock for the remove queue.
-    Semaphore       m_to_remove_count;  // Number of threads to remove.
-    Semaphore       m_is_empty;         // Flag when the Callable queue is empty.
-    Semaphore       m_actions;          // Number of actions available.
-    Semaphore       m_to_stop;          // Number of threads to stop.
-    Semaphore       m_running_threads;  // Number of threads to allow running.
-};
+    /**
+     * @brief Add a Callable object to the Thread Pool at a given time.
+     * Timers are kept by an idle thread of the Thread Pool, with a
+     * resolution of TIMER_TICK, and are discarded on Finish. The thread
+     * keeping time never blocks: a timer due while the queue is full is
+     * dropped, whatever the Overflow policy, and counted in
+     * OverflowStats::m_timer_drops.
+     * @param call_ Callable object to execute. It is moved from.
+     * @param at_ Time to push the Callable at.
+     * @return TimerHandle Handle for CancelTimer. Invalid if finished.
+     */
+    TimerHandle PushAt(Callable &&call_,
+                       std::chrono::steady_clock::time_point at_);
 
-/* implementation ----------------------------------------------------------- */
+    /**
+     * @brief Add a Callable object to the Thread Pool after a delay. Dropped
+     * if the queue is full by then, see PushAt.
+     * @param call_ Callable object to execute. It is moved from.
+     * @param delay_ Time to wait before pushing the Callable.
+     * @return TimerHandle Handle for CancelTimer. Invalid if finished.
+     */
+    TimerHandle PushAfter(Callable &&call_, std::chrono::nanoseconds delay_);
 
-template<class Callable>
-const size_t ThreadPool<Callable>::THREAD_MAX = thread::hardware_concurrency();
+    /**
+     * @brief Add a Callable object to the Thread Pool every period, starting
+     * one period from now, until cancelled. Every run gets a copy of the
+     * Callable. Callables that can not be copied, such as Task, are shared
+     * between the runs instead, and must not run longer than the period.
+     * A run due while the queue is full is dropped, see PushAt, and the
+     * timer goes on with the next period.
+     * @param call_ Callable object to execute. It is moved from.
+     * @param period_ Time between runs. At least TIMER_TICK.
+     * @return TimerHandle Handle for CancelTimer. Invalid if finished.
+     */
+    TimerHandle PushPeriodic(Callable &&call_,
+                             std::chrono::nanoseconds period_);
 
-template<class Callable>
-ThreadPool<Callable>::ThreadPool(size_t threads_num_):
-    m_status(Status::RUNNING),
-    m_threads(),
-    m_calls(),
-    m_calls_lock(),
-    m_to_remove(),
-    m_remove_lock(),
-    m_to_remove_count(0),
-    m_is_empty(0),
-    m_actions(0),
-    m_to_stop(0),
-    m_running_threads(threads_num_)
-{
-    AddThreads(threads_num_);
-}
+    /**
+     * @brief Cancel a timer added by PushAt, PushAfter or PushPeriodic.
+     * @param handle_ Handle of the timer.
+     * @return bool False if the timer was already pushed or cancelled.
+     */
+    bool CancelTimer(TimerHandle handle_);
 
-template<class Callable>
-ThreadPool<Callable>::~ThreadPool()
-{
-    // Finish working threads without completing all Callables.
-    Finish(false);
-}
+    /**
+     * @brief Add a batch of Callable objects to the Thread Pool, under a
+     * single lock and with a single signal to it's threads. The Callable
+     * objects are moved out of the batch. In STEALING mode, the whole batch is
+     * added to one queue, and other threads steal from it.
+     * @tparam Iterator Forward iterator to Callable objects.
+     * @param first_ Beginning of the batch.
+     * @param last_ End of the batch.
+     * @return bool Did the action succeed. If the Container is full, only
+     * part of the batch is added and false is returned.
+     */
+    template<class Iterator>
+    bool PushBatch(Iterator first_, Iterator last_);
 
-template<class Callable>
-bool ThreadPool<Callable>::Pause()
-{
-    // If status is not RUNNING.
-    switch (m_status)
-    {
-        case Status::PAUSED:    return true;
-        case Status::FINISHED:  return false;
-    }
+    /**
+     * @brief Same as PushBatch(first_, last_), for a whole range.
+     * @tparam Range Range of Callable objects, such as std::vector.
+     * @param range_ Batch of Callable objects to move out.
+     * @return bool Did the action succeed.
+     */
+    template<class Range>
+    bool PushBatch(Range &range_);
 
-    // Do not allow any threads to run.
-    for (size_t i = 0; i < GetSize(); ++i)
-    {
-        m_running_threads.wait();
-    }
+    /**
+     * @brief Add a call of func_ with args_ to the Thread Pool, and get it's
+     * result through a future. Requires Callable to be constructible from a
+     * callable object, such as Task.
+     * @param func_ Function to call.
+     * @param args_ Arguments to call func_ with. They are copied or moved
+     * into the Callable.
+     * @return future Result of the call, or the exception it has thrown.
+     * Invalid if the Thread Pool is finished.
+     */
+    template<class Func, class... Args>
+    future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+    Submit(Func &&func_, Args&&... args_);
 
-    // Signal threads to recieve pause.
-    m_actions.post(GetSize());
-}
+    /**
+     * @brief Return the number of working threads.
+     * @return size_t Number of working threads.
+     */
+    size_t GetSize() const;
 
-template<class Callable>
-bool ThreadPool<Callable>::Continue()
-{
-    // If status is not PAUSED
-    switch (m_status)
+    /**
+     * @brief Return the Thread Pool's statistics.
+     * @return Stats::Snapshot Current statistics. Empty with NoStats.
+     */
+    typename Stats::Snapshot GetStats() const;
+
+    /**
+     * @brief Return the counters of the pushes to a full queue.
+     */
+    OverflowStats GetOverflowStats() const;
+
+    /**
+     * @brief Return the Thread Pool of the calling thread, nullptr if it is
+     * not one of a Thread Pool's threads of this type.
+     */
+    static ThreadPool *Current() noexcept;
+
+    static const std::chrono::nanoseconds TIMER_TICK;   // Timer resolution.
+
+private:
+    static const size_t THREAD_MAX;
+    static const size_t CACHE_LINE = 64;    // Unit of false sharing.
+
+    /**
+     * @brief Callable shared between the runs of a periodic timer, when it
+     * can not be copied.
+     */
+    struct SharedCall
     {
-        case Status::RUNNING:   return true;
-        case Status::FINISHED:  return false;
-        default: break;
-    }
+        void operator()() { (*m_call)(); }
 
-    // Allow all threads to run again.
-    m_running_threads.post(GetSize());
+        std::shared_ptr<Callable>   m_call;
+    };
 
-    return true;
-}
+    /**
+     * @brief Callable waiting in the timer wheel.
+     */
+    struct Timer
+    {
+        Callable                    m_call;     // Callable to push.
+        std::shared_ptr<Callable>   m_shared;   // Periodic, not copyable.
+    };
 
-template<class Callable>
-bool ThreadPool<Callable>::Finish(bool let_complete_)
-{
-    if (Status::FINISHED == m_status) return false;
+    /**
+     * @brief Entry tagged with the drain epoch it was pushed in.
+     */
+    struct Item
+    {
+        Item() = default;
 
-    // Resume in case the Thread Pool was paused.
-    Continue();
+        Item(Entry &&entry_, size_t epoch_,
+             CancelToken &&token_ = CancelToken()):
+            m_entry(move(entry_)), m_epoch(epoch_), m_token(move(token_))
+        {}
 
-    // Wait for all Callables to complete if flagged to do so.
-    if (let_complete_) m_is_empty.wait();
+        friend bool operator<(const Item &lhs_, const Item &rhs_)
+        {
+            return (lhs_.m_entry < rhs_.m_entry);
+        }
 
-    m_status = Status::FINISHED;
+        int GetPriority() const { return m_entry.GetPriority(); }
 
-    // End all working threads.
-    RemoveThreads(GetSize());
+        Entry           m_entry;        // Callable to execute.
+        size_t          m_epoch = 0;    // Index in m_pending.
+        CancelToken     m_token;        // Dropped unpopped once cancelled.
+    };
 
-    return true;
-}
+    /**
+     * @brief Iterator over a batch of Callables, tagging them as Items.
+     */
+    template<class Iterator>
+    struct ItemIterator
+    {
+        Item operator*() const { return Item(Entry(move(*m_it)), m_epoch); }
+        ItemIterator &operator++() { ++m_it; return *this; }
+        bool operator!=(const ItemIterator &other_) const
+        {
+            return (m_it != other_.m_it);
+        }
 
-template<class Callable>
-bool ThreadPool<Callable>::SetNumOfThreads(size_t nthread_)
-{
-    if (Status::FINISHED == m_status) return false;
-    if (nthread_ > THREAD_MAX) throw(length_error(
-        "Number of threads excide the allowed value."
-    ));
+        Iterator        m_it;           // Current Callable.
+        size_t          m_epoch;        // Drain epoch of the batch.
+    };
 
-    if (GetSize() <= nthread_)
+    typedef typename Container::template Rebind<Item> Queue;
+
+    /**
+     * @brief Per thread queue used in STEALING mode. Aligned to a cache line
+     * to avoid false sharing between neighbouring queues.
+     */
+    struct alignas(CACHE_LINE) WorkQueue
     {
-        AddThreads(nthread_ - GetSize());
-    }
-    else
+        deque<Item>     m_calls;        // Callable objects queue.
+        mutex           m_lock;         // Lock for the queue's actions.
+    };
+
+    /**
+     * @brief Registry entry of a thread slot. A slot gets a thread on it's
+     * first use and keeps it until the Thread Pool finishes: a removed thread
+     * parks on it's own m_wake, and is reused before new threads are made.
+     */
+    struct alignas(CACHE_LINE) Worker
     {
-        RemoveThreads(GetSize() - nthread_);
-    }
+        Worker(): m_thread(), m_wake(0) {}
 
-    return true;
-}
+        thread          m_thread;       // Thread of the slot, if made yet.
+        Semaphore       m_wake;         // Posted to reuse or end it, parked.
+    };
 
-template<class Callable>
-bool ThreadPool<Callable>::Push(Callable &call_)
-{
-    if (Status::FINISHED == m_status) return false;
+    /**
+     * @brief Slots that have a running thread, for the outside pushes to pick
+     * from without a lock. Changed under m_park_lock. A reader may still pick
+     * a slot that just parked, it's Callables are stolen then.
+     */
+    struct LiveSlots
+    {
+        explicit LiveSlots(size_t capacity_ = 0):
+            m_slots(new atomic<size_t>[capacity_]()),
+            m_size(0)
+        {}
+
+        /**
+         * @brief Add slot_, which must not be in the set already.
+         */
+        void Add(size_t slot_);
+
+        /**
+         * @brief Remove slot_ if it is in the set.
+         */
+        void Remove(size_t slot_);
+
+        /**
+         * @brief Pick the slot of round-robin index next_.
+         * @return bool Was the set not empty.
+         */
+        bool Pick(size_t next_, size_t &slot_) const;
+
+        std::unique_ptr<atomic<size_t>[]>
+                        m_slots;        // Slots, the first m_size are live.
+        atomic<size_t>  m_size;         // Number of live slots.
+    };
+
+    static_assert(0 == sizeof(WorkQueue) % CACHE_LINE &&
+                  0 == sizeof(Worker) % CACHE_LINE,
+                  "Neighbouring thread slots must not share cache lines.");
 
-    unique_lock<mutex> guard(m_calls_lock); // Critical section start.
+    /**
+     * @brief Return the first Callable object from Thread Pool.
+     * @param slot_ Slot of the calling thread.
+     * @return Item Object to execute.
+     */
+    Item Pop(size_t slot_);
 
-    m_calls.push(call_);
+    /**
+     * @brief Try to take a Callable object from the thread's own queue, or
+     * steal one from the other queues.
+     * @param slot_ Slot of the calling thread.
+     * @param call_ Output Callable object.
+     * @return bool Was a Callable object found.
+     */
+    bool TrySteal(size_t slot_, Item &call_);
 
-    guard.unlock();                         // Critical section end.
+    /**
+     * @brief Choose the queue for a Push in STEALING mode.
+     * @return WorkQueue& The pushing thread's own queue, or the next running
+     * thread's queue in round-robin order for outside threads.
+     */
+    WorkQueue &PushQueue();
 
-    // Signal available Callable
-    m_actions.post();
+    /**
+     * @brief Add slot_ to the running slots the outside pushes pick from, or
+     * remove it. Requires m_park_lock. Does nothing unless STEALING.
+     */
+    void SetLive(size_t slot_, bool is_live_);
 
-    // Mark Callable queue as not empty
-    m_is_empty.try_wait();
-} 
+    /**
+     * @brief Move a Callable object into the Thread Pool and signal it.
+     * @param call_ Callable object to execute.
+     * @param try_refused_ If set, refuse when full instead of following the
+     * overflow policy, and count the refusal in it.
+     * @return bool Did the action succeed.
+     */
+    bool Enqueue(Callable &&call_, CancelToken &&token_ = CancelToken(),
+                 atomic<size_t> *try_refused_ = nullptr);
 
-template<class Callable>
-size_t ThreadPool<Callable>::GetSize() const
-{
-    return m_threads.size();
-}
+    /**
+     * @brief Reserve space in the queue for up to n_ Callables.
+     * @return size_t Number reserved, n_ while unbounded.
+     */
+    size_t Reserve(size_t n_);
 
-template<class Callable>
-Callable ThreadPool<Callable>::Pop()
-{
-    unique_lock<mutex> guard(m_calls_lock); // Critical section start.
+    /**
+     * @brief Give back space reserved or taken by queued Callables, and wake
+     * a Push waiting for it.
+     */
+    void Release(size_t n_);
 
-    Callable ret(move(m_calls.top()));
-    m_calls.pop();
+    /**
+     * @brief Reserve space for a Callable by the BLOCK or DROP_OLDEST
+     * policy, once Reserve failed.
+     * @param try_refused_ If set, refuse instead of following the policy,
+     * and count the refusal in it.
+     * @return bool Was space reserved. False if refused.
+     */
+    bool MakeSpace(atomic<size_t> *try_refused_);
 
-    return ret;
-}                                           // Critical section end.
+    /**
+     * @brief Take the queued Callable that would run next, and drop it.
+     * Looks through the queues once, never waits for a Callable.
+     * @return bool False if every queued Callable is taken by a thread, or
+     * none was found yet.
+     */
+    bool TryDropOldest();
 
-template<class Callable>
-void ThreadPool<Callable>::ThreadLoop()
-{
-    while (1)
-    {
-        // Wait for available actions.
-        m_actions.wait();
+    /**
+     * @brief Main loop for threads to run, get Callable object and execute it.
+     * @param slot_ Slot of the thread, used to index it's queue.
+     */
+    void ThreadLoop(size_t slot_);
 
-        // Handle Callable object if has access.
-        if (m_running_threads.try_wait())
-        {
-            // If a thread needs to be stopped, end loop.
-            if (m_to_stop.try_wait()) break;
+    /**
+     * @brief Add threads to Thread pool, reusing parked threads first.
+     * @param nthread_ Number of threads to add.
+     */
+    void AddThreads(size_t nthread_);
 
-            // Call the first Callable object.
-            Callable call(Pop());
-            call();
-        }
-        else // If not, wait for access.
-        {
-            m_running_threads.wait();
-        }
+    /**
+     * @brief Add a single thread, a parked one if any, otherwise a new one
+     * in a slot not used yet. Requires m_resize_lock.
+     * @param is_blocking_ Wait for a removed thread to park if every slot is
+     * in use already.
+     * @return bool False if not blocking and no thread could be added.
+     */
+    bool AddThread(bool is_blocking_);
 
-        // Free current access given by Thread Pool
-        m_running_threads.post();
-    }
+    /**
+     * @brief Remove threads from Thread pool. Returns at once, the first
+     * threads to take an action park instead of calling a Callable.
+     * @param nthread_ Number of threads to remove.
+     */
+    void RemoveThreads(size_t nthread_);
 
-    // Clean up thread.
-    unique_lock<mutex> guard(m_remove_lock);    // Critical section start.
+    /**
+     * @brief Claim one of the threads to remove, if any.
+     * @return bool Should the calling thread park.
+     */
+    bool TryClaimPark();
 
-    m_to_remove.push(std::this_thread::get_id());
+    /**
+     * @brief Park the calling thread until it is reused or the Thread Pool
+     * finishes. The calling thread holds no run permit.
+     * @param slot_ Slot of the calling thread.
+     * @return bool True if reused, false if it should end.
+     */
+    bool Park(size_t slot_);
 
-    guard.unlock();                             // Critical section end.
+    /**
+     * @brief Join every thread made. Blocks until they all end, requires
+     * StopAll.
+     */
+    void JoinThreads();
 
-    m_to_remove_count.post();
+    /**
+     * @brief Allow the threads to run again and set RUNNING. Requires
+     * m_resize_lock.
+     * @return vector Callbacks of a pause cancelled before it was complete,
+     * to call once m_resize_lock is released.
+     */
+    vector<std::function<void()>> Resume();
 
-}
+    /**
+     * @brief Give a run permit to a pending pause instead of releasing it.
+     * @return size_t Permits owed before, 0 if no pause is pending. The payer
+     * of the last permit, 1, calls OnPaused().
+     */
+    size_t PayPause();
 
-template<class Callable>
-void ThreadPool<Callable>::AddThreads(size_t nthread_)
-{
-    for (size_t i = 0; i < nthread_; ++i)
-    {
-        thread new_thread(&ThreadPool<Callable>::ThreadLoop, this);
-        m_threads.insert(std::pair<thread::id, thread&&>(new_thread.get_id(), move(new_thread)));
-    }
+    /**
+     * @brief Call the callbacks of a complete pause.
+     */
+    void OnPaused();
 
-    m_running_threads.post(nthread_);
-}
+    /**
+     * @brief Mark n_ Callables of a drain epoch as done, and wake the ones
+     * waiting for it to be empty.
+     */
+    void Complete(size_t epoch_, size_t n_ = 1);
 
-template<class Callable>
-void ThreadPool<Callable>::RemoveThreads(size_t nthread_)
-{
-    // Set number of threads to end.
-    m_to_stop.post(nthread_);
+    /**
+     * @brief Return true if no Callable is pending in any drain epoch.
+     */
+    bool IsDrained() const;
 
-    // Signal available stop action.
-    m_actions.post(nthread_);
+    /**
+     * @brief Pass the exception being handled to the error callback.
+     */
+    void OnError() noexcept;
 
-    for (size_t i = 0; i < nthread_; ++i)
-    {
-        m_to_remove_count.wait();
+    /**
+     * @brief Make all the threads end, without taking the Callables left.
+     * Requires FINISHED. Only the first call has an effect.
+     */
+    void StopAll();
 
-        unique_lock<mutex> guard(m_remove_lock);    // Critical section start.
+    /**
+     * @brief Wait for an action, or until the idle timeout when auto scaling.
+     * @return bool Is an action available.
+     */
+    bool WaitForAction();
 
-        // Erase thread by id after it finishes.
-        m_threads.at(m_to_remove.front()).join();
-        m_threads.erase(m_to_remove.front());
-        m_to_remove.pop();
+    /**
+     * @brief Poll for an action as set by SetIdlePolicy, without parking.
+     * @param spin_ Time to spin for, in ns.
+     * @param total_ Time to spin and yield for, in ns.
+     * @return bool Was an action taken.
+     */
+    bool SpinForAction(uint64_t spin_, uint64_t total_);
+
+    /**
+     * @brief Signal n_ new Callables, waking parked threads only when no
+     * thread spins to take them.
+     */
+    void Signal(size_t n_);
+
+    /**
+     * @brief Hint the CPU that the thread is spinning.
+     */
+    static void CpuRelax() noexcept;
+
+    /**
+     * @brief Add a thread if auto scaling and the threads are all busy for
+     * longer than the wait target. Never blocks.
+     */
+    void TryGrow();
+
+    /**
+     * @brief Retire the calling idle thread if auto scaling allows it.
+     * Never blocks.
+     * @return bool Should the calling thread park.
+     */
+    bool TryRetire();
+
+    /**
+     * @brief Add a timer to the wheel and make sure a thread keeps time.
+     */
+    TimerHandle AddTimer(Timer &&timer_, uint64_t due_, uint64_t period_);
+
+    /**
+     * @brief Push the Callables of the timers that are due.
+     */
+    void ServiceTimers();
+
+    /**
+     * @brief Wake an idle thread to keep time for the timers, unless one was
+     * woken already.
+     */
+    void KickTimers();
+
+    /**
+     * @brief Return the Callable to push for a run of a periodic timer.
+     */
+    static Callable Repeat(Timer &timer_);
+
+    /**
+     * @brief Convert a time to a tick of the timer wheel, rounding up.
+     */
+    uint64_t ToTick(std::chrono::steady_clock::time_point time_) const;
+
+    /* members -------------------------------------------------------------- */
+    // Read mostly, set on construction and by the control calls.
+    atomic<Status>  m_status;           // Thread Pool run status.
+    Scheduling      m_scheduling;       // Thread Pool scheduling mode.
+    atomic<size_t>  m_capacity;         // Maximum m_queued, 0 if unbounded.
+    atomic<Overflow> m_overflow;        // Policy of a Push when full.
+    atomic<size_t>  m_drain_epoch;      // Epoch of new Callables, 0 or 1.
+    atomic<size_t>  m_drain_waiters;    // Threads blocked in Drain.
+    atomic<size_t>  m_to_park;          // Threads to park on their action.
+    atomic<size_t>  m_owed;             // Run permits a pause waits for.
+    atomic<size_t>  m_scale_max;        // Auto scale maximum, 0 if disabled.
+    atomic<uint64_t> m_spin_time;       // Idle time spinning, in ns.
+    atomic<uint64_t> m_yield_time;      // Idle time yielding, in ns.
+    atomic<size_t>  m_spawn_limit;      // Queued per thread to Spawn inline.
+    atomic<bool>    m_is_finishing;     // Stop once all Callables are done.
+    atomic<bool>    m_is_stopping;      // Threads end on their next action.
+    Affinity        m_affinity;         // Placement of the threads.
+    vector<Worker>  m_workers;          // Thread of every slot.
+    vector<WorkQueue>                   // Per thread queues (STEALING only).
+                    m_queues;
+    LiveSlots       m_live_slots;       // Running slots (STEALING only).
+    deque<LiveSlots>                    // Running slots of each node
+                    m_node_slots;       // (STEALING only).
+    vector<Arena>   m_arenas;           // Scratch memory of every slot.
+
+    // Written by the pushing threads.
+    alignas(CACHE_LINE)
+    atomic<size_t>  m_next_queue;       // Round-robin index for outside Push.
+    atomic<size_t>  m_space_waiters;    // Pushes blocked for space.
+
+    // Written by both the pushing threads and the Thread Pool's threads, each
+    // on it's own cache lines.
+    alignas(CACHE_LINE)
+    atomic<size_t>  m_queued;           // Callables not taken by a thread.
+    alignas(CACHE_LINE)
+    atomic<size_t>  m_pending[2];       // Callables not done, per epoch.
+    alignas(CACHE_LINE)
+    Queue           m_calls;            // Callable objects queue (PRIORITY).
+    alignas(CACHE_LINE)
+    Semaphore       m_actions;          // Number of actions available.
+
+    // Written by the Thread Pool's threads.
+    alignas(CACHE_LINE)
+    Semaphore       m_running_threads;  // Number of threads to allow running.
+    alignas(CACHE_LINE)
+    atomic<size_t>  m_idle_threads;     // Threads waiting for action.
+    atomic<size_t>  m_spinning;         // Threads spinning or yielding.
+    atomic<uint64_t> m_last_idle;       // Last time a thread was idle, in ns.
+    alignas(CACHE_LINE)
+    Stats           m_stats;            // Statistics policy.
+
+    // Cold, used by resizing, overflow, timers and the lifecycle calls.
+    alignas(CACHE_LINE)
+    atomic<size_t>  m_num_threads;      // Number of threads not removed.
+    atomic<size_t>  m_num_made;         // Number of threads made.
+    mutex           m_resize_lock;      // Lock for changing thread number.
+    size_t          m_next_slot;        // First slot with no thread yet.
+    vector<size_t>  m_parked;           // Slots of the parked threads.
+    mutex           m_park_lock;        // Lock for parked and live slots.
+    Semaphore       m_num_parked;       // Number of parked slots.
+    atomic<size_t>  m_scale_min;        // Auto scale minimum threads.
+    atomic<uint64_t> m_wait_target;     // Auto scale wait target in ns.
+    atomic<uint64_t> m_idle_timeout;    // Auto scale idle timeout in ns.
+    mutex           m_space_lock;       // Lock for the blocked pushes.
+    condition_variable                  // Signaled when space is released.
+                    m_space;
+    atomic<size_t>  m_num_blocked;      // See OverflowStats.
+    atomic<size_t>  m_num_rejected;
+    atomic<size_t>  m_num_dropped;
+    atomic<size_t>  m_num_inlined;
+    atomic<size_t>  m_num_timer_drops;
+    std::chrono::steady_clock::time_point
+                    m_epoch;            // Time of timer wheel tick 0.
+    TimerWheel<Timer>                   // Timers waiting to be pushed.
+                    m_timers;
+    mutex           m_timer_lock;       // Lock for the timer wheel.
+    atomic<size_t>  m_num_timers;       // Number of timers in the wheel.
+    atomic<bool>    m_is_keeper;        // Does a thread keep time.
+    atomic<bool>    m_is_kicked;        // Is a thread woken to keep time.
+    Semaphore       m_timer_kicks;      // Number of wakes to keep time.
+    mutex           m_drain_lock;       // Lock for the drain epoch flip.
+    condition_variable                  // Signaled when an epoch is done.
+                    m_drained;
+    uint64_t        m_pause_start;      // Time the pause started.
+    mutex           m_callback_lock;    // Lock for the lifecycle callbacks.
+    vector<std::function<void()>>       // Callbacks waiting for the pause.
+                    m_on_paused;
+    std::function<void()>               // Callback waiting for the finish.
+                    m_on_finished;
+    std::function<void(std::exception_ptr)>
+                    m_on_error;         // Callback for thrown exceptions.
+    atomic<size_t>  m_to_exit;          // Threads to end until finished.
+
+    static thread_local ThreadPool *s_pool; // Pool of the current thread.
+    static thread_local size_t      s_slot; // Slot of the current thread.
+};
+
+/* implementation ----------------------------------------------------------- */
+
+template<class Callable, class Container, class Stats>
+const size_t ThreadPool<Callable, Container, Stats>::THREAD_MAX =
+    thread::hardware_concurrency();
+
+template<class Callable, class Container, class Stats>
+const std::chrono::nanoseconds
+ThreadPool<Callable, Container, Stats>::TIMER_TICK =
+    std::chrono::milliseconds(1);
+
+template<class Callable, class Container, class Stats>
+thread_local ThreadPool<Callable, Container, Stats> *
+ThreadPool<Callable, Container, Stats>::s_pool = nullptr;
+
+template<class Callable, class Container, class Stats>
+thread_local size_t ThreadPool<Callable, Container, Stats>::s_slot = 0;
+
+template<class Callable, class Container, class Stats>
+ThreadPool<Callable, Container, Stats>::ThreadPool(size_t threads_num_,
+                                            Scheduling scheduling_,
+                                            const Affinity &affinity_):
+    m_status(Status::RUNNING),
+    m_scheduling(scheduling_),
+    m_capacity(0),
+    m_overflow(BLOCK),
+    m_drain_epoch(0),
+    m_drain_waiters(0),
+    m_to_park(0),
+    m_owed(0),
+    m_scale_max(0),
+    m_spin_time(0),
+    m_yield_time(0),
+    m_spawn_limit(2),
+    m_is_finishing(false),
+    m_is_stopping(false),
+    m_affinity(affinity_),
+    m_workers(std::max(threads_num_, THREAD_MAX)),
+    m_queues(Scheduling::STEALING == scheduling_ ?
+             std::max(threads_num_, THREAD_MAX) : 0),
+    m_live_slots(m_queues.size()),
+    m_node_slots(),
+    m_arenas(std::max(threads_num_, THREAD_MAX)),
+    m_next_queue(0),
+    m_space_waiters(0),
+    m_queued(0),
+    m_pending(),
+    m_calls(),
+    m_actions(0),
+    m_running_threads(0),
+    m_idle_threads(0),
+    m_spinning(0),
+    m_last_idle(0),
+    m_stats(std::max(threads_num_, THREAD_MAX)),
+    m_num_threads(0),
+    m_num_made(0),
+    m_resize_lock(),
+    m_next_slot(0),
+    m_parked(),
+    m_park_lock(),
+    m_num_parked(0),
+    m_scale_min(0),
+    m_wait_target(0),
+    m_idle_timeout(0),
+    m_space_lock(),
+    m_space(),
+    m_num_blocked(0),
+    m_num_rejected(0),
+    m_num_dropped(0),
+    m_num_inlined(0),
+    m_num_timer_drops(0),
+    m_epoch(std::chrono::steady_clock::now()),
+    m_timers(0),
+    m_timer_lock(),
+    m_num_timers(0),
+    m_is_keeper(false),
+    m_is_kicked(false),
+    m_timer_kicks(0),
+    m_drain_lock(),
+    m_drained(),
+    m_pause_start(0),
+    m_callback_lock(),
+    m_on_paused(),
+    m_on_finished(),
+    m_on_error(),
+    m_to_exit(0)
+{
+    static_assert(CACHE_LINE <= alignof(ThreadPool),
+                  "The hot members must start their own cache lines.");
+
+    m_parked.reserve(m_workers.size());
+
+    // Group the running slots by their node, filled as threads start.
+    if (1 < m_affinity.GetNumOfNodes() && !m_queues.empty())
+    {
+        for (size_t i = 0; i < m_affinity.GetNumOfNodes(); ++i)
+        {
+            m_node_slots.emplace_back(m_queues.size());
+        }
+    }
+
+    AddThreads(threads_num_);
+}
+
+template<class Callable, class Container, class Stats>
+ThreadPool<Callable, Container, Stats>::~ThreadPool()
+{
+    // Finish working threads without completing all Callables.
+    Finish(false);
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::Pause()
+{
+    std::shared_ptr<Semaphore> paused = std::make_shared<Semaphore>(0);
+
+    if (!PauseAsync([paused](){ paused->post(); })) return false;
+
+    paused->wait();
+
+    return (Status::PAUSED == m_status);
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::PauseAsync(
+    std::function<void()> on_paused_)
+{
+    unique_lock<mutex> resize(m_resize_lock);
+
+    switch (m_status)
+    {
+        case Status::FINISHED:  return false;
+        case Status::PAUSED:
+        {
+            unique_lock<mutex> guard(m_callback_lock);
+
+            // Pause still pending, wait for it.
+            if (0 < m_owed)
+            {
+                m_on_paused.push_back(move(on_paused_));
+                return true;
+            }
+
+            break;
+        }
+        default:
+        {
+            unique_lock<mutex> guard(m_callback_lock);
+            m_on_paused.push_back(move(on_paused_));
+            guard.unlock();
+
+            m_pause_start = m_stats.Now();
+
+            // Every run permit is owed, the threads pay theirs once their
+            // Callable ends.
+            m_owed = GetSize();
+            m_status = Status::PAUSED;
+
+            bool is_paused = (0 == GetSize());
+
+            // Take the permits of the idle threads now.
+            while (!is_paused && m_running_threads.try_wait())
+            {
+                size_t owed = PayPause();
+                if (0 == owed)
+                {
+                    m_running_threads.post();
+                    break;
+                }
+
+                is_paused = (1 == owed);
+            }
+
+            resize.unlock();
+
+            if (is_paused) OnPaused();
+
+            return true;
+        }
+    }
+
+    resize.unlock();
+
+    // Already paused.
+    on_paused_();
+
+    return true;
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::Continue()
+{
+    unique_lock<mutex> resize(m_resize_lock);
+
+    // If status is not PAUSED
+    switch (m_status)
+    {
+        case Status::RUNNING:   return true;
+        case Status::FINISHED:  return false;
+        default: break;
+    }
+
+    vector<std::function<void()>> cancelled(Resume());
+
+    resize.unlock();
+
+    for (std::function<void()> &callback : cancelled) callback();
+
+    return true;
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::Finish(bool let_complete_)
+{
+    bool ret = FinishAsync(std::function<void()>(), let_complete_);
+
+    // Also stop a Thread Pool finishing asynchronously.
+    if (!let_complete_) StopAll();
+
+    unique_lock<mutex> resize(m_resize_lock);
+
+    JoinThreads();
+
+    return ret;
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::FinishAsync(
+    std::function<void()> on_finished_, bool let_complete_)
+{
+    unique_lock<mutex> resize(m_resize_lock);
+
+    if (Status::FINISHED == m_status) return false;
+
+    // Resume in case the Thread Pool was paused.
+    vector<std::function<void()>> cancelled;
+    if (Status::PAUSED == m_status) cancelled = Resume();
+
+    m_status = Status::FINISHED;
+
+    // Discard the timers left.
+    unique_lock<mutex> timers(m_timer_lock);
+    m_timers.Clear();
+    m_num_timers = 0;
+    timers.unlock();
+
+    unique_lock<mutex> guard(m_callback_lock);
+    m_on_finished = move(on_finished_);
+    guard.unlock();
+
+    // End all working threads, once the Callables are done if flagged to.
+    // Parked threads and threads yet to park end as well.
+    m_to_exit = m_num_made.load();
+    bool is_finished = (0 == m_to_exit);
+
+    if (!let_complete_ || is_finished)
+    {
+        StopAll();
+    }
+    else
+    {
+        // The thread completing the last Callable stops the rest. Push is
+        // refused already, so no Callable is added meanwhile.
+        m_is_finishing = true;
+        if (IsDrained()) StopAll();
+    }
+
+    resize.unlock();
+
+    for (std::function<void()> &callback : cancelled) callback();
+
+    if (is_finished && m_on_finished) m_on_finished();
+
+    return true;
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::Drain()
+{
+    unique_lock<mutex> guard(m_drain_lock);     // Critical section start.
+
+    ++m_drain_waiters;
+
+    // The other epoch is reused for the Callables pushed from now on, so
+    // wait for an earlier Drain's Callables to be done first.
+    m_drained.wait(guard, [this]()
+    {
+        return (m_is_stopping || 0 == m_pending[m_drain_epoch ^ 1]);
+    });
+
+    size_t epoch = m_drain_epoch;
+    m_drain_epoch = epoch ^ 1;
+
+    m_drained.wait(guard, [this, epoch]()
+    {
+        return (m_is_stopping || 0 == m_pending[epoch]);
+    });
+
+    --m_drain_waiters;
+}                                               // Critical section end.
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::SetNumOfThreads(size_t nthread_)
+{
+    if (Status::RUNNING != m_status) return false;
+    if (nthread_ > THREAD_MAX) throw(length_error(
+        "Number of threads excide the allowed value."
+    ));
+
+    unique_lock<mutex> resize(m_resize_lock);
+    if (Status::RUNNING != m_status) return false;
+
+    uint64_t start = m_stats.Now();
+
+    if (GetSize() <= nthread_)
+    {
+        AddThreads(nthread_ - GetSize());
+    }
+    else
+    {
+        RemoveThreads(GetSize() - nthread_);
+    }
+
+    m_stats.OnTransition(start, Transition::RESIZE);
+
+    return true;
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::SetAutoScale(
+    size_t min_, size_t max_, std::chrono::nanoseconds wait_target_,
+    std::chrono::nanoseconds idle_timeout_)
+{
+    if (Status::FINISHED == m_status) return false;
+    if (max_ > THREAD_MAX || min_ > max_) throw(length_error(
+        "Number of threads excide the allowed value."
+    ));
+
+    m_scale_min = min_;
+    m_wait_target = wait_target_.count();
+    m_idle_timeout = idle_timeout_.count();
+    m_last_idle = PoolStats::Clock();
+    m_scale_max = max_;
+
+    return true;
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::StopAutoScale()
+{
+    m_scale_max = 0;
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::SetIdlePolicy(
+    std::chrono::microseconds spin_, std::chrono::microseconds yield_)
+{
+    m_spin_time = std::chrono::nanoseconds(spin_).count();
+    m_yield_time = std::chrono::nanoseconds(yield_).count();
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::SetSpawnLimit(size_t limit_)
+{
+    m_spawn_limit = limit_;
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::SetCapacity(size_t capacity_,
+                                                         Overflow overflow_)
+{
+    if (Status::FINISHED == m_status) return false;
+
+    m_overflow = overflow_;
+    m_capacity = capacity_;
+
+    // Let the blocked pushes check the new capacity.
+    unique_lock<mutex> guard(m_space_lock);
+    m_space.notify_all();
+
+    return true;
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::SetErrorHandler(
+    std::function<void(std::exception_ptr)> on_error_)
+{
+    unique_lock<mutex> guard(m_callback_lock);  // Critical section start.
+
+    m_on_error = move(on_error_);
+}                                               // Critical section end.
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::Push(Callable &call_)
+{
+    return Enqueue(Callable(call_));
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::Push(Callable &&call_)
+{
+    return Enqueue(move(call_));
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::TryPush(Callable &&call_)
+{
+    return Enqueue(move(call_), CancelToken(), &m_num_rejected);
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::Spawn(Callable &&call_)
+{
+    if (this != s_pool) return Push(move(call_));
+    if (Status::FINISHED == m_status) return false;
+
+    size_t limit = m_spawn_limit.load(std::memory_order_relaxed);
+    bool is_saturated = false;
+
+    if (Scheduling::STEALING == m_scheduling)
+    {
+        WorkQueue &work = m_queues[s_slot];
+
+        unique_lock<mutex> guard(work.m_lock);  // Critical section start.
+
+        is_saturated = (work.m_calls.size() >= limit);
+    }                                           // Critical section end.
+    else
+    {
+        is_saturated = (m_queued.load(std::memory_order_relaxed) >=
+                        limit * std::max<size_t>(GetSize(), 1));
+    }
+
+    if (!is_saturated) return Push(move(call_));
+
+    // The calling thread has enough queued to share already. Not counted,
+    // the counters would be written by every thread.
+    call_();
+
+    return true;
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::Push(Callable &&call_,
+                                                  CancelToken token_)
+{
+    if (token_.IsCancelled()) return false;
+
+    return Enqueue(move(call_), move(token_));
+}
+
+template<class Callable, class Container, class Stats>
+template<class... Args>
+bool ThreadPool<Callable, Container, Stats>::Emplace(Args&&... args_)
+{
+    if (Status::FINISHED == m_status) return false;
+
+    return Enqueue(Callable(std::forward<Args>(args_)...));
+}
+
+template<class Callable, class Container, class Stats>
+TimerHandle ThreadPool<Callable, Container, Stats>::PushAt(
+    Callable &&call_, std::chrono::steady_clock::time_point at_)
+{
+    Timer timer;
+    timer.m_call = move(call_);
+
+    return AddTimer(move(timer), ToTick(at_), 0);
+}
+
+template<class Callable, class Container, class Stats>
+TimerHandle ThreadPool<Callable, Container, Stats>::PushAfter(
+    Callable &&call_, std::chrono::nanoseconds delay_)
+{
+    return PushAt(move(call_), std::chrono::steady_clock::now() + delay_);
+}
+
+template<class Callable, class Container, class Stats>
+TimerHandle ThreadPool<Callable, Container, Stats>::PushPeriodic(
+    Callable &&call_, std::chrono::nanoseconds period_)
+{
+    static_assert(std::is_copy_constructible<Callable>::value ||
+                  std::is_constructible<Callable, SharedCall>::value,
+                  "PushPeriodic requires a copyable Callable, or one that "
+                  "can wrap any callable object, like Task.");
+
+    Timer timer;
+    if constexpr (std::is_copy_constructible<Callable>::value)
+    {
+        timer.m_call = move(call_);
+    }
+    else
+    {
+        timer.m_shared = std::make_shared<Callable>(move(call_));
+    }
+
+    uint64_t period = std::max<uint64_t>(period_ / TIMER_TICK, 1);
+
+    return AddTimer(move(timer),
+                    ToTick(std::chrono::steady_clock::now() + period_),
+                    period);
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::CancelTimer(TimerHandle handle_)
+{
+    unique_lock<mutex> guard(m_timer_lock);     // Critical section start.
+
+    bool ret = m_timers.Cancel(handle_);
+    m_num_timers = m_timers.Size();
+
+    return ret;
+}                                               // Critical section end.
+
+template<class Callable, class Container, class Stats>
+template<class Iterator>
+bool ThreadPool<Callable, Container, Stats>::PushBatch(Iterator first_,
+                                                       Iterator last_)
+{
+    size_t total = std::distance(first_, last_);
+    if (0 == total) return (Status::FINISHED != m_status);
+
+    // Counted as pending before any thread can complete them.
+    size_t epoch = m_drain_epoch;
+    m_pending[epoch] += total;
+
+    if (Status::FINISHED == m_status)
+    {
+        Complete(epoch, total);
+        return false;
+    }
+
+    // The Callables beyond the capacity are refused.
+    size_t reserved = Reserve(total);
+    if (reserved < total)
+    {
+        m_num_rejected += total - reserved;
+        last_ = std::next(first_, reserved);
+    }
+
+    size_t count = 0;
+
+    if (Scheduling::STEALING == m_scheduling)
+    {
+        WorkQueue &work = PushQueue();
+
+        unique_lock<mutex> guard(work.m_lock);  // Critical section start.
+
+        for (; first_ != last_; ++first_, ++count)
+        {
+            work.m_calls.push_back(Item(Entry(move(*first_)), epoch));
+        }
+    }                                           // Critical section end.
+    else
+    {
+        count = m_calls.PushBatch(ItemIterator<Iterator>{first_, epoch},
+                                  ItemIterator<Iterator>{last_, epoch});
+    }
+
+    if (count < reserved) Release(reserved - count);
+
+    bool is_complete = (count == total);
+    if (!is_complete) Complete(epoch, total - count);
+
+    if (0 == count) return false;
+
+    m_stats.OnPush(count);
+
+    // Signal all available Callables at once
+    Signal(count);
+
+    TryGrow();
+
+    return is_complete;
+}
+
+template<class Callable, class Container, class Stats>
+template<class Range>
+bool ThreadPool<Callable, Container, Stats>::PushBatch(Range &range_)
+{
+    return PushBatch(std::begin(range_), std::end(range_));
+}
+
+template<class Callable, class Container, class Stats>
+template<class Func, class... Args>
+future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+ThreadPool<Callable, Container, Stats>::Submit(Func &&func_, Args&&... args_)
+{
+    typedef std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>
+            Result;
+
+    std::promise<Result> promise;
+    future<Result> result(promise.get_future());
+
+    Callable call(details::MakeSubmitCall(move(promise),
+                                          std::forward<Func>(func_),
+                                          std::forward<Args>(args_)...));
+
+    if (!Enqueue(move(call))) return future<Result>();
+
+    return result;
+}
+
+template<class Callable, class Container, class Stats>
+OverflowStats ThreadPool<Callable, Container, Stats>::GetOverflowStats() const
+{
+    OverflowStats ret;
+
+    ret.m_blocked = m_num_blocked;
+    ret.m_rejected = m_num_rejected;
+    ret.m_dropped = m_num_dropped;
+    ret.m_inlined = m_num_inlined;
+    ret.m_timer_drops = m_num_timer_drops;
+
+    return ret;
+}
+
+template<class Callable, class Container, class Stats>
+ThreadPool<Callable, Container, Stats> *
+ThreadPool<Callable, Container, Stats>::Current() noexcept
+{
+    return s_pool;
+}
+
+template<class Callable, class Container, class Stats>
+size_t ThreadPool<Callable, Container, Stats>::GetSize() const
+{
+    return m_num_threads;
+}
+
+template<class Callable, class Container, class Stats>
+typename Stats::Snapshot
+ThreadPool<Callable, Container, Stats>::GetStats() const
+{
+    return m_stats.GetSnapshot();
+}
+
+template<class Callable, class Container, class Stats>
+typename ThreadPool<Callable, Container, Stats>::Item
+ThreadPool<Callable, Container, Stats>::Pop(size_t slot_)
+{
+    if (Scheduling::STEALING == m_scheduling)
+    {
+        Item ret;
+
+        // An action is available, so a Callable object is in one of the
+        // queues - but it may be moved by other threads while searching.
+        while (!TrySteal(slot_, ret))
+        {
+            std::this_thread::yield();
+        }
+
+        return ret;
+    }
+
+    Item ret;
+
+    // Same as above, a lock-free Container may still be completing a Push.
+    while (!m_calls.Pop(ret))
+    {
+        std::this_thread::yield();
+    }
+
+    return ret;
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::TrySteal(size_t slot_,
+                                                      Item &call_)
+{
+    // Own queue first, newest Callable for cache locality.
+    {
+        WorkQueue &work = m_queues[slot_];
+        unique_lock<mutex> guard(work.m_lock);  // Critical section start.
+
+        if (!work.m_calls.empty())
+        {
+            call_ = move(work.m_calls.back());
+            work.m_calls.pop_back();
+
+            return true;
+        }
+    }                                           // Critical section end.
+
+    // Steal oldest Callable from the other queues, own node's queues first.
+    const size_t node = m_affinity.GetNode(slot_);
+    const bool is_numa = !m_node_slots.empty();
+
+    for (size_t pass = 0; pass < (is_numa ? 2 : 1); ++pass)
+    {
+        for (size_t i = 1; i < m_queues.size(); ++i)
+        {
+            size_t index = (slot_ + i) % m_queues.size();
+            if (is_numa && ((0 == pass) != (node == m_affinity.GetNode(index))))
+            {
+                continue;
+            }
+
+            WorkQueue &victim = m_queues[index];
+            unique_lock<mutex> guard(victim.m_lock, std::try_to_lock);
+
+            if (guard.owns_lock() && !victim.m_calls.empty())
+            {
+                call_ = move(victim.m_calls.front());
+                victim.m_calls.pop_front();
+
+                m_stats.OnSteal(slot_, index);
+
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+template<class Callable, class Container, class Stats>
+typename ThreadPool<Callable, Container, Stats>::WorkQueue &
+ThreadPool<Callable, Container, Stats>::PushQueue()
+{
+    // Prefer the pushing thread's own queue.
+    if (this == s_pool) return m_queues[s_slot];
+
+    size_t next = m_next_queue.fetch_add(1);
+    size_t slot = 0;
+
+    // Then a running thread's queue on the pushing thread's node, then any
+    // running thread's queue.
+    if (!m_node_slots.empty())
+    {
+        const LiveSlots &slots = m_node_slots[Affinity::CurrentNode() %
+                                              m_node_slots.size()];
+
+        if (slots.Pick(next, slot)) return m_queues[slot];
+    }
+
+    if (m_live_slots.Pick(next, slot)) return m_queues[slot];
+
+    // No thread running, stolen from once one is.
+    return m_queues[next % m_queues.size()];
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::SetLive(size_t slot_,
+                                                     bool is_live_)
+{
+    if (m_queues.empty()) return;
+
+    LiveSlots *node = nullptr;
+    if (!m_node_slots.empty())
+    {
+        node = &m_node_slots[m_affinity.GetNode(slot_)];
+    }
+
+    if (is_live_)
+    {
+        m_live_slots.Add(slot_);
+        if (node) node->Add(slot_);
+    }
+    else
+    {
+        m_live_slots.Remove(slot_);
+        if (node) node->Remove(slot_);
+    }
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::LiveSlots::Add(size_t slot_)
+{
+    size_t size = m_size.load(std::memory_order_relaxed);
+
+    // Published by the size, a reader never picks it before.
+    m_slots[size].store(slot_, std::memory_order_relaxed);
+    m_size.store(size + 1, std::memory_order_release);
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::LiveSlots::Remove(size_t slot_)
+{
+    size_t size = m_size.load(std::memory_order_relaxed);
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (slot_ != m_slots[i].load(std::memory_order_relaxed)) continue;
+
+        // The last slot takes it's place, a reader sees either one.
+        size_t last = m_slots[size - 1].load(std::memory_order_relaxed);
+        m_slots[i].store(last, std::memory_order_relaxed);
+        m_size.store(size - 1, std::memory_order_release);
+
+        return;
+    }
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::LiveSlots::Pick(
+    size_t next_, size_t &slot_) const
+{
+    size_t size = m_size.load(std::memory_order_acquire);
+    if (0 == size) return false;
+
+    slot_ = m_slots[next_ % size].load(std::memory_order_relaxed);
+
+    return true;
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::Enqueue(
+    Callable &&call_, CancelToken &&token_, atomic<size_t> *try_refused_)
+{
+    // Counted as pending before checking the status, so a finishing Thread
+    // Pool either refuses the Callable or waits for it.
+    size_t epoch = m_drain_epoch;
+    ++m_pending[epoch];
+
+    if (Status::FINISHED == m_status)
+    {
+        Complete(epoch);
+        return false;
+    }
+
+    if (0 == Reserve(1))
+    {
+        Overflow overflow = m_overflow;
+
+        // Blocking the pool's own thread could leave no thread to make space.
+        if (!try_refused_ && (RUN_INLINE == overflow ||
+                              (BLOCK == overflow && this == s_pool)))
+        {
+            ++m_num_inlined;
+
+            try
+            {
+                call_();
+            }
+            catch (...)
+            {
+                Complete(epoch);
+                throw;
+            }
+
+            Complete(epoch);
+            return true;
+        }
+
+        if (!MakeSpace(try_refused_))
+        {
+            Complete(epoch);
+            return false;
+        }
+    }
+
+    if (Scheduling::STEALING == m_scheduling)
+    {
+        WorkQueue &work = PushQueue();
+
+        unique_lock<mutex> guard(work.m_lock);  // Critical section start.
+
+        work.m_calls.push_back(Item(Entry(move(call_)), epoch, move(token_)));
+    }                                           // Critical section end.
+    else if (!m_calls.Push(Item(Entry(move(call_)), epoch, move(token_))))
+    {
+        Release(1);
+        Complete(epoch);
+        return false;
+    }
+
+    m_stats.OnPush(1);
+
+    // Signal available Callable
+    Signal(1);
+
+    TryGrow();
+
+    return true;
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::ThreadLoop(size_t slot_)
+{
+    s_pool = this;
+    s_slot = slot_;
+
+    m_affinity.Apply(slot_);
+
+    Arena &arena = m_arenas[slot_];
+    Arena::SetCurrent(&arena);
+
+    while (1)
+    {
+        // Wait for available actions.
+        m_stats.OnIdleBegin(slot_);
+        bool has_action = WaitForAction();
+        m_stats.OnIdleEnd(slot_);
+
+        // Idle for too long, park if allowed.
+        if (!has_action)
+        {
+            if (TryRetire() && !Park(slot_)) break;
+            continue;
+        }
+
+        // Wait for access, blocks while the Thread Pool is paused.
+        m_running_threads.wait();
+
+        // If finished, end loop and leave the Callables left.
+        if (m_is_stopping) break;
+
+        // If a thread needs to be removed, park with the run permit taken.
+        if (TryClaimPark())
+        {
+            if (!Park(slot_)) break;
+            continue;
+        }
+
+        // Call the first Callable object, unless cancelled while queued.
+        {
+            Item call(Pop(slot_));
+            Release(1);
+
+            if (call.m_token.IsCancelled())
+            {
+                m_stats.OnCancel(slot_);
+            }
+            else
+            {
+                CancelToken::SetCurrent(&call.m_token);
+                details::RunEntry(m_stats, slot_, call.m_entry,
+                                  [this](){ OnError(); });
+                CancelToken::SetCurrent(nullptr);
+            }
+
+            Complete(call.m_epoch);
+        }
+
+        // Scratch memory lives as long as the Callable.
+        arena.Reset();
+
+        // Free current access given by Thread Pool, unless a pause waits.
+        size_t owed = PayPause();
+        if (0 == owed) m_running_threads.post();
+        if (1 == owed) OnPaused();
+    }
+
+    // Clean up thread.
+    Arena::SetCurrent(nullptr);
+
+    // Last thread to end calls back FinishAsync.
+    if (1 == m_to_exit.fetch_sub(1))
+    {
+        unique_lock<mutex> callbacks(m_callback_lock);
+        std::function<void()> on_finished(move(m_on_finished));
+        callbacks.unlock();
+
+        if (on_finished) on_finished();
+    }
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::AddThreads(size_t nthread_)
+{
+    for (size_t i = 0; i < nthread_; ++i) AddThread(true);
+
+    m_num_threads += nthread_;
+    m_running_threads.post(nthread_);
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::AddThread(bool is_blocking_)
+{
+    // Every slot has a thread, one of them is on it's way to park.
+    if (m_next_slot == m_workers.size())
+    {
+        if (is_blocking_)
+        {
+            m_num_parked.wait();
+        }
+        else if (!m_num_parked.try_wait())
+        {
+            return false;
+        }
+    }
+    else if (!m_num_parked.try_wait())
+    {
+        size_t slot = m_next_slot++;
+
+        unique_lock<mutex> guard(m_park_lock);
+        SetLive(slot, true);
+        guard.unlock();
+
+        ++m_num_made;
+        m_workers[slot].m_thread = thread(&ThreadPool::ThreadLoop, this, slot);
+
+        return true;
+    }
+
+    unique_lock<mutex> guard(m_park_lock);      // Critical section start.
+
+    size_t slot = m_parked.back();
+    m_parked.pop_back();
+    SetLive(slot, true);
+
+    guard.unlock();                             // Critical section end.
+
+    m_workers[slot].m_wake.post();
+
+    return true;
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::RemoveThreads(size_t nthread_)
+{
+    m_num_threads -= nthread_;
+    m_to_park += nthread_;
+
+    // Signal available park actions, taken before any Callable.
+    m_actions.post(nthread_);
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::TryClaimPark()
+{
+    size_t to_park = m_to_park.load(std::memory_order_relaxed);
+
+    while (0 < to_park)
+    {
+        if (m_to_park.compare_exchange_weak(to_park, to_park - 1)) return true;
+    }
+
+    return false;
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::Park(size_t slot_)
+{
+    unique_lock<mutex> guard(m_park_lock);      // Critical section start.
+
+    // StopAll wakes only the threads parked before it.
+    if (m_is_stopping) return false;
+
+    m_parked.push_back(slot_);
+    SetLive(slot_, false);
+
+    guard.unlock();                             // Critical section end.
+
+    m_num_parked.post();
+    m_workers[slot_].m_wake.wait();
+
+    return !m_is_stopping;
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::JoinThreads()
+{
+    for (Worker &worker : m_workers)
+    {
+        if (worker.m_thread.joinable()) worker.m_thread.join();
+    }
+
+    m_num_threads = 0;
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::WaitForAction()
+{
+    bool is_scaling = (0 != m_scale_max.load(std::memory_order_relaxed));
+    bool ret = true;
+
+    uint64_t spin = m_spin_time.load(std::memory_order_relaxed);
+    uint64_t total = spin + m_yield_time.load(std::memory_order_relaxed);
+    bool is_spinning = (0 != total);
+
+    if (is_scaling)
+    {
+        ++m_idle_threads;
+        m_last_idle = PoolStats::Clock();
+    }
+
+    const std::chrono::steady_clock::time_point idle_end =
+        std::chrono::steady_clock::now() +
+        std::chrono::nanoseconds(m_idle_timeout);
+
+    while (1)
+    {
+        if (is_spinning && SpinForAction(spin, total))
+        {
+            ret = true;
+        }
+        // A single idle thread keeps time while there are timers.
+        else if (0 < m_num_timers && !m_is_keeper.exchange(true))
+        {
+            ret = m_actions.timed_wait(TIMER_TICK);
+            ServiceTimers();
+            m_is_keeper = false;
+
+            bool is_idle_end = is_scaling &&
+                               std::chrono::steady_clock::now() >= idle_end;
+            if (!ret && !is_idle_end) continue;
+        }
+        else if (!is_scaling)
+        {
+            m_actions.wait();
+            ret = true;
+        }
+        else
+        {
+            ret = m_actions.timed_wait(
+                idle_end - std::chrono::steady_clock::now()
+            );
+        }
+
+        // Woken to keep time, the action is someone else's.
+        if (ret && m_timer_kicks.try_wait())
+        {
+            m_is_kicked = false;
+            continue;
+        }
+
+        // Leaving, let another thread keep time.
+        if (0 < m_num_timers && !m_is_keeper) KickTimers();
+
+        break;
+    }
+
+    if (is_scaling) --m_idle_threads;
+
+    // Pushed while a thread was spinning, no parked thread was woken for
+    // the Callables left.
+    if (ret && is_spinning && 0 == m_spinning) m_actions.notify();
+
+    return ret;
+}
+
+template<class Callable, class Container, class Stats>
+size_t ThreadPool<Callable, Container, Stats>::Reserve(size_t n_)
+{
+    size_t capacity = m_capacity.load(std::memory_order_relaxed);
+
+    if (0 == capacity)
+    {
+        m_queued.fetch_add(n_, std::memory_order_relaxed);
+        return n_;
+    }
+
+    size_t queued = m_queued.load(std::memory_order_relaxed);
+    size_t ret = 0;
+
+    do
+    {
+        if (queued >= capacity) return 0;
+        ret = std::min(n_, capacity - queued);
+    }
+    while (!m_queued.compare_exchange_weak(queued, queued + ret));
+
+    return ret;
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::Release(size_t n_)
+{
+    m_queued.fetch_sub(n_);
+
+    // Only lock when a Push waits, see MakeSpace.
+    if (0 == m_space_waiters) return;
+
+    unique_lock<mutex> guard(m_space_lock);
+    m_space.notify_all();
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::MakeSpace(
+    atomic<size_t> *try_refused_)
+{
+    Overflow overflow = m_overflow;
+
+    if (try_refused_)
+    {
+        ++*try_refused_;
+        return false;
+    }
+
+    if (REJECT == overflow)
+    {
+        ++m_num_rejected;
+        return false;
+    }
+
+    if (DROP_OLDEST == overflow)
+    {
+        // Every queued Callable may be taken by a thread meanwhile.
+        while (0 == Reserve(1))
+        {
+            if (Status::FINISHED == m_status) return false;
+            if (!TryDropOldest()) std::this_thread::yield();
+        }
+
+        return true;
+    }
+
+    ++m_num_blocked;
+
+    unique_lock<mutex> guard(m_space_lock);     // Critical section start.
+
+    ++m_space_waiters;
+    m_space.wait(guard, [this]()
+    {
+        return (m_is_stopping || 0 != Reserve(1));
+    });
+    --m_space_waiters;
+
+    // Reserved unless stopping.
+    return !m_is_stopping;
+}                                               // Critical section end.
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::TryDropOldest()
+{
+    // Owns the action of the dropped Callable, so one is in a queue - unless
+    // it is an action of StopAll, or the Callable's Push is not done yet.
+    if (!m_actions.try_wait()) return false;
+
+    Item dropped;
+    bool is_found = false;
+
+    if (Scheduling::STEALING == m_scheduling)
+    {
+        // Oldest Callable of the first queue holding any.
+        for (size_t i = 0; i < m_queues.size() && !is_found; ++i)
+        {
+            WorkQueue &work = m_queues[i];
+            unique_lock<mutex> guard(work.m_lock);
+
+            if (!work.m_calls.empty())
+            {
+                dropped = move(work.m_calls.front());
+                work.m_calls.pop_front();
+                is_found = true;
+            }
+        }
+    }
+    else
+    {
+        is_found = m_calls.Pop(dropped);
+    }
+
+    // The action goes back for a thread, the caller tries again.
+    if (!is_found)
+    {
+        Signal(1);
+        return false;
+    }
+
+    Release(1);
+    m_stats.OnDrop(1);
+    ++m_num_dropped;
+    Complete(dropped.m_epoch);
+
+    return true;
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::SpinForAction(uint64_t spin_,
+                                                           uint64_t total_)
+{
+    ++m_spinning;
+
+    bool ret = false;
+    uint64_t start = PoolStats::Clock();
+
+    for (uint64_t now = start; now - start < total_; now = PoolStats::Clock())
+    {
+        if ((ret = m_actions.try_wait())) break;
+
+        if (now - start < spin_)
+        {
+            CpuRelax();
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    --m_spinning;
+
+    return ret;
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::Signal(size_t n_)
+{
+    // A spinning thread takes it without a wake, see WaitForAction.
+    if (0 < m_spinning)
+    {
+        m_actions.post_quiet(n_);
+    }
+    else
+    {
+        m_actions.post(n_);
+    }
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::CpuRelax() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::TryGrow()
+{
+    if (0 == m_scale_max.load(std::memory_order_relaxed)) return;
+
+    // Grow only when every thread is busy for longer than the target.
+    if (0 < m_idle_threads || GetSize() >= m_scale_max) return;
+    if (PoolStats::Clock() - m_last_idle < m_wait_target) return;
+
+    unique_lock<mutex> resize(m_resize_lock, std::try_to_lock);
+    if (!resize.owns_lock() || Status::RUNNING != m_status) return;
+    if (GetSize() >= m_scale_max) return;
+
+    // Give the new thread a full wait target before growing again.
+    m_last_idle = PoolStats::Clock();
+
+    if (AddThread(false))
+    {
+        ++m_num_threads;
+        m_running_threads.post();
+    }
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::TryRetire()
+{
+    unique_lock<mutex> resize(m_resize_lock, std::try_to_lock);
+    if (!resize.owns_lock() || Status::RUNNING != m_status) return false;
+    if (0 == m_scale_max || GetSize() <= m_scale_min) return false;
+
+    // Take this thread's run permit along with it, like a removed thread.
+    if (!m_running_threads.try_wait()) return false;
+
+    --m_num_threads;
+
+    return true;
+}
+
+template<class Callable, class Container, class Stats>
+vector<std::function<void()>> ThreadPool<Callable, Container, Stats>::Resume()
+{
+    // Permits paid already were never released by the threads.
+    size_t owed = m_owed.exchange(0);
+    m_running_threads.post(GetSize() - owed);
+
+    m_status = Status::RUNNING;
+
+    vector<std::function<void()>> cancelled;
+    if (0 < owed)
+    {
+        unique_lock<mutex> guard(m_callback_lock);
+        cancelled.swap(m_on_paused);
+    }
+
+    return cancelled;
+}
+
+template<class Callable, class Container, class Stats>
+size_t ThreadPool<Callable, Container, Stats>::PayPause()
+{
+    size_t owed = m_owed.load(std::memory_order_relaxed);
+
+    while (0 < owed && !m_owed.compare_exchange_weak(owed, owed - 1)) {}
+
+    return owed;
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::OnPaused()
+{
+    unique_lock<mutex> guard(m_callback_lock);  // Critical section start.
+
+    vector<std::function<void()>> paused;
+    paused.swap(m_on_paused);
+
+    guard.unlock();                             // Critical section end.
+
+    m_stats.OnTransition(m_pause_start, Transition::PAUSE);
+
+    for (std::function<void()> &callback : paused) callback();
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::Complete(size_t epoch_,
+                                                      size_t n_)
+{
+    if (n_ != m_pending[epoch_].fetch_sub(n_)) return;
+
+    if (0 < m_drain_waiters)
+    {
+        unique_lock<mutex> guard(m_drain_lock);
+        m_drained.notify_all();
+    }
+
+    if (m_is_finishing && IsDrained()) StopAll();
+}
+
+template<class Callable, class Container, class Stats>
+bool ThreadPool<Callable, Container, Stats>::IsDrained() const
+{
+    return (0 == m_pending[0] && 0 == m_pending[1]);
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::OnError() noexcept
+{
+    std::function<void(std::exception_ptr)> on_error;
+
+    try
+    {
+        unique_lock<mutex> guard(m_callback_lock);
+        on_error = m_on_error;
+    }
+    catch (...)
+    {
+        return;                 // No copy of the callback, dropped.
+    }
+
+    details::PassError(on_error, std::current_exception());
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::StopAll()
+{
+    if (m_is_stopping.exchange(true)) return;
+
+    // Blocked pushes are refused.
+    unique_lock<mutex> space(m_space_lock);
+    m_space.notify_all();
+    space.unlock();
+
+    // Every thread ends on it's next action, parked threads at once.
+    m_actions.post(GetSize());
+
+    unique_lock<mutex> parked(m_park_lock);
+    for (size_t slot : m_parked) m_workers[slot].m_wake.post();
+    parked.unlock();
+
+    unique_lock<mutex> guard(m_drain_lock);
+    m_drained.notify_all();
+}
+
+template<class Callable, class Container, class Stats>
+TimerHandle ThreadPool<Callable, Container, Stats>::AddTimer(
+    Timer &&timer_, uint64_t due_, uint64_t period_)
+{
+    if (Status::FINISHED == m_status) return TimerHandle();
+
+    unique_lock<mutex> guard(m_timer_lock);     // Critical section start.
+
+    TimerHandle ret = m_timers.Add(move(timer_), due_, period_);
+    m_num_timers = m_timers.Size();
+
+    guard.unlock();                             // Critical section end.
+
+    if (!m_is_keeper) KickTimers();
+
+    return ret;
+}
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::ServiceTimers()
+{
+    unique_lock<mutex> guard(m_timer_lock);     // Critical section start.
+
+    // Only whole ticks that have passed.
+    uint64_t now = (std::chrono::steady_clock::now() - m_epoch) / TIMER_TICK;
+
+    m_timers.Advance(now, [this](Timer &timer_, bool is_periodic_)
+    {
+        // Dropped if full and counted as a timer drop only, the thread
+        // keeping time never blocks. A periodic timer still runs on it's
+        // next period.
+        Enqueue(is_periodic_ ? Repeat(timer_) : move(timer_.m_call),
+                CancelToken(), &m_num_timer_drops);
+    });
+
+    m_num_timers = m_timers.Size();
+}                                               // Critical section end.
+
+template<class Callable, class Container, class Stats>
+void ThreadPool<Callable, Container, Stats>::KickTimers()
+{
+    if (m_is_kicked.exchange(true)) return;
+
+    m_timer_kicks.post();
+    m_actions.post();
+}
+
+template<class Callable, class Container, class Stats>
+Callable ThreadPool<Callable, Container, Stats>::Repeat(Timer &timer_)
+{
+    if constexpr (std::is_copy_constructible<Callable>::value)
+    {
+        return Callable(timer_.m_call);
+    }
+    else if constexpr (std::is_constructible<Callable, SharedCall>::value)
+    {
+        return Callable(SharedCall{timer_.m_shared});
+    }
+    else
+    {
+        // Not reached, PushPeriodic does not compile.
+        return Callable();
+    }
+}
+
+template<class Callable, class Container, class Stats>
+uint64_t ThreadPool<Callable, Container, Stats>::ToTick(
+    std::chrono::steady_clock::time_point time_) const
+{
+    if (time_ <= m_epoch) return 0;
 
-    }   // Critical section end.
+    return (time_ - m_epoch + TIMER_TICK - std::chrono::nanoseconds(1)) /
+           TIMER_TICK;
 }
 
 /* -------------------------------------------------------------------------- */
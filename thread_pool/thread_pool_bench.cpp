@@ -0,0 +1,647 @@
+/* -------------------------------------------------------------------------- */
+/* thread_pool_bench.cpp                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <algorithm>            // std::sort
+#include <array>                // std::array
+#include <atomic>               // std::atomic
+#include <chrono>               // std::chrono::steady_clock
+#include <cstdint>              // uint64_t
+#include <iostream>             // std::cout
+#include <memory>               // std::unique_ptr
+#include <string>               // std::string
+#include <vector>               // std::vector
+
+#include "executor_group.hpp"
+#include "pool_trace.hpp"
+#include "static_thread_pool.hpp"
+#include "thread_pool.hpp"
+
+/* -------------------------------------------------------------------------- */
+/* import symbols                                                             */
+/* -------------------------------------------------------------------------- */
+
+using std::chrono::duration;
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+using std::string;
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Every result is printed as a single JSON object per line:
+ * {"bench": name, "pool": variant, "threads": n, "metric": name,
+ *  "value": number, "unit": unit}
+ */
+static void Report(const string &bench_, const string &pool_, size_t threads_,
+                   const string &metric_, double value_, const string &unit_)
+{
+    std::cout << "{\"bench\": \"" << bench_ << "\", "
+              << "\"pool\": \"" << pool_ << "\", "
+              << "\"threads\": " << threads_ << ", "
+              << "\"metric\": \"" << metric_ << "\", "
+              << "\"value\": " << value_ << ", "
+              << "\"unit\": \"" << unit_ << "\"}" << std::endl;
+}
+
+static uint64_t Now()
+{
+    return duration_cast<nanoseconds>(
+        steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+static double Seconds(steady_clock::time_point start_)
+{
+    return duration<double>(steady_clock::now() - start_).count();
+}
+
+/* -------------------------------------------------------------------------- */
+/* callables                                                                  */
+/* -------------------------------------------------------------------------- */
+
+static atomic<size_t> s_counter(0);
+
+static void WaitForCount(size_t count_)
+{
+    while (s_counter < count_) std::this_thread::yield();
+}
+
+/**
+ * @brief Empty Callable, only counts it's calls.
+ */
+class Count
+{
+public:
+    void operator()()
+    {
+        s_counter.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+bool operator<(const Count&, const Count&)
+{
+    return false;
+}
+
+/**
+ * @brief Callable recording the time from it's Push to it's start.
+ */
+class Stamp
+{
+public:
+    Stamp(uint64_t *sample_ = nullptr): m_pushed(Now()), m_sample(sample_) {}
+
+    void operator()()
+    {
+        *m_sample = Now() - m_pushed;
+        s_counter.fetch_add(1, std::memory_order_release);
+    }
+
+private:
+    uint64_t    m_pushed;
+    uint64_t   *m_sample;
+};
+
+bool operator<(const Stamp&, const Stamp&)
+{
+    return false;
+}
+
+/* -------------------------------------------------------------------------- */
+/* thread pool benchmarks                                                     */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Push empty Callables one by one from a single thread, and measure
+ * the rate they complete at.
+ */
+template<class Pool>
+static void BenchThroughput(const string &pool_, size_t threads_,
+                            typename Pool::Scheduling scheduling_)
+{
+    const size_t calls = 200000;
+    s_counter = 0;
+
+    Pool pool(threads_, scheduling_);
+    Count call;
+
+    steady_clock::time_point start = steady_clock::now();
+
+    for (size_t i = 0; i < calls; ++i)
+    {
+        while (!pool.Push(call)) std::this_thread::yield();
+    }
+    WaitForCount(calls);
+
+    Report("throughput", pool_, threads_, "calls_per_second",
+           calls / Seconds(start), "1/s");
+}
+
+/**
+ * @brief Spread empty Callables over three executors: three Thread Pools of
+ * threads_ threads each, against one Executor Group of threads_ threads.
+ */
+static void BenchGroup(size_t threads_)
+{
+    const size_t calls = 300000;
+    const size_t executors = 3;
+
+    s_counter = 0;
+    {
+        std::vector<std::unique_ptr<ThreadPool<Count>>> pools;
+        for (size_t i = 0; i < executors; ++i)
+        {
+            pools.emplace_back(new ThreadPool<Count>(threads_));
+        }
+        Count call;
+
+        steady_clock::time_point start = steady_clock::now();
+
+        for (size_t i = 0; i < calls; ++i)
+        {
+            while (!pools[i % executors]->Push(call))
+            {
+                std::this_thread::yield();
+            }
+        }
+        WaitForCount(calls);
+
+        Report("group", "pools", threads_ * executors, "calls_per_second",
+               calls / Seconds(start), "1/s");
+    }
+
+    s_counter = 0;
+    {
+        ExecutorGroup group(threads_);
+        std::vector<Executor<Count>*> lanes;
+        for (size_t i = 0; i < executors; ++i)
+        {
+            lanes.push_back(&group.AddExecutor<Count>(i + 1));
+        }
+
+        steady_clock::time_point start = steady_clock::now();
+
+        for (size_t i = 0; i < calls; ++i) lanes[i % executors]->Push(Count());
+        WaitForCount(calls);
+
+        Report("group", "group", threads_, "calls_per_second",
+               calls / Seconds(start), "1/s");
+    }
+}
+
+/**
+ * @brief Push empty Callables from several threads at once, so the pushing
+ * threads and the Thread Pool's threads write the pool's state together.
+ */
+template<class Pool>
+static void BenchProducers(const string &pool_, size_t threads_,
+                           typename Pool::Scheduling scheduling_)
+{
+    const size_t calls = 200000;
+    const size_t producers = 4;
+    s_counter = 0;
+
+    Pool pool(threads_, scheduling_);
+    std::vector<thread> pushers;
+
+    steady_clock::time_point start = steady_clock::now();
+
+    for (size_t i = 0; i < producers; ++i)
+    {
+        pushers.emplace_back([&pool, calls, producers]()
+        {
+            Count call;
+
+            for (size_t j = 0; j < calls / producers; ++j)
+            {
+                while (!pool.Push(call)) std::this_thread::yield();
+            }
+        });
+    }
+    for (thread &pusher : pushers) pusher.join();
+    WaitForCount(calls);
+
+    Report("producers", pool_, threads_, "calls_per_second",
+           calls / Seconds(start), "1/s");
+}
+
+/**
+ * @brief Split into two halves until depth_ is 0, then count. Pushed back
+ * through the queue with Push, or inline once saturated with Spawn.
+ */
+static void Split(size_t depth_, bool is_spawn_)
+{
+    if (0 == depth_)
+    {
+        s_counter.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    ThreadPool<Task> *pool = ThreadPool<Task>::Current();
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        Task half([depth_, is_spawn_](){ Split(depth_ - 1, is_spawn_); });
+
+        if (is_spawn_) pool->Spawn(std::move(half));
+        else pool->Push(std::move(half));
+    }
+}
+
+/**
+ * @brief Run a recursive split of tiny Callables, with Push against Spawn.
+ */
+static void BenchNested(size_t threads_)
+{
+    const size_t depth = 17;
+
+    for (bool is_spawn : { false, true })
+    {
+        s_counter = 0;
+
+        ThreadPool<Task> pool(threads_, ThreadPool<Task>::STEALING);
+
+        steady_clock::time_point start = steady_clock::now();
+
+        pool.Push(Task([depth, is_spawn](){ Split(depth, is_spawn); }));
+        WaitForCount(size_t(1) << depth);
+
+        Report("nested", is_spawn ? "spawn" : "push", threads_,
+               "leaves_per_second", (size_t(1) << depth) / Seconds(start),
+               "1/s");
+    }
+}
+
+/**
+ * @brief Same as BenchThroughput, on a StaticThreadPool of Threads threads.
+ */
+template<size_t Threads>
+static void BenchStatic()
+{
+    const size_t calls = 200000;
+    s_counter = 0;
+
+    StaticThreadPool<Count, Threads> pool;
+    Count call;
+
+    steady_clock::time_point start = steady_clock::now();
+
+    for (size_t i = 0; i < calls; ++i)
+    {
+        while (!pool.Push(call)) std::this_thread::yield();
+    }
+    WaitForCount(calls);
+
+    Report("throughput", "static", Threads, "calls_per_second",
+           calls / Seconds(start), "1/s");
+}
+
+/**
+ * @brief Compare Push in a loop against a single PushBatch.
+ */
+static void BenchPushBatch(size_t threads_)
+{
+    const size_t calls = 100000;
+    ThreadPool<Count> pool(threads_);
+    Count call;
+
+    s_counter = 0;
+    steady_clock::time_point start = steady_clock::now();
+
+    for (size_t i = 0; i < calls; ++i) pool.Push(call);
+    WaitForCount(calls);
+
+    Report("push_batch", "priority", threads_, "push_loop_seconds",
+           Seconds(start), "s");
+
+    std::vector<Count> batch(calls);
+
+    s_counter = 0;
+    start = steady_clock::now();
+
+    pool.PushBatch(batch);
+    WaitForCount(calls);
+
+    Report("push_batch", "priority", threads_, "push_batch_seconds",
+           Seconds(start), "s");
+}
+
+/**
+ * @brief Fill a container with Tasks of three priorities, then empty it,
+ * from a single thread. Compares the heap with the priority bands.
+ */
+template<class Queue>
+static void BenchQueue(const string &queue_)
+{
+    const size_t calls = 1000000;
+    Queue queue;
+    Task call;
+
+    steady_clock::time_point start = steady_clock::now();
+
+    for (size_t i = 0; i < calls; ++i)
+    {
+        queue.Push(Task(Count(), static_cast<int>(i % 3)));
+    }
+    while (queue.Pop(call)) {}
+
+    Report("queue", queue_, 1, "push_pop_per_second",
+           calls / Seconds(start), "1/s");
+}
+
+/**
+ * @brief Push Callables one at a time to an idle pool, and report
+ * percentiles of the time from Push to start.
+ */
+static void BenchLatency(size_t threads_, const string &pool_,
+                         std::chrono::microseconds spin_)
+{
+    const size_t samples = 20000;
+    std::vector<uint64_t> latency(samples);
+    s_counter = 0;
+
+    ThreadPool<Stamp> pool(threads_);
+    pool.SetIdlePolicy(spin_);
+
+    for (size_t i = 0; i < samples; ++i)
+    {
+        Stamp call(&latency[i]);
+        pool.Push(call);
+
+        while (s_counter.load(std::memory_order_acquire) <= i)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    std::sort(latency.begin(), latency.end());
+
+    const double percentiles[] = { 50, 90, 99, 99.9 };
+    const char *names[] = { "p50", "p90", "p99", "p999" };
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        size_t index = static_cast<size_t>(percentiles[i] / 100 * samples);
+        Report("latency", pool_, threads_, names[i],
+               latency[std::min(index, samples - 1)], "ns");
+    }
+}
+
+/**
+ * @brief Measure the cost of a Pause and Continue pair on an idle pool.
+ */
+static void BenchPause(size_t threads_)
+{
+    const size_t rounds = 1000;
+    ThreadPool<Count> pool(threads_);
+
+    steady_clock::time_point start = steady_clock::now();
+
+    for (size_t i = 0; i < rounds; ++i)
+    {
+        pool.Pause();
+        pool.Continue();
+    }
+
+    Report("pause_continue", "priority", threads_, "round_ns",
+           Seconds(start) * 1e9 / rounds, "ns");
+}
+
+/**
+ * @brief Measure the cost of growing to threads_ and shrinking back to one.
+ */
+static void BenchResize(size_t threads_)
+{
+    const size_t rounds = 100;
+    ThreadPool<Count> pool(1);
+
+    steady_clock::time_point start = steady_clock::now();
+
+    for (size_t i = 0; i < rounds; ++i)
+    {
+        pool.SetNumOfThreads(threads_);
+        pool.SetNumOfThreads(1);
+    }
+
+    Report("resize", "priority", threads_, "round_ns",
+           Seconds(start) * 1e9 / rounds, "ns");
+}
+
+/**
+ * @brief Measure adding and cancelling a million pending timers, like
+ * connection timeouts that almost never fire.
+ */
+static void BenchTimers(size_t threads_)
+{
+    const size_t timers = 1000000;
+    ThreadPool<Count> pool(threads_);
+    std::vector<TimerHandle> handles(timers);
+
+    steady_clock::time_point start = steady_clock::now();
+
+    for (size_t i = 0; i < timers; ++i)
+    {
+        handles[i] = pool.PushAfter(Count(), std::chrono::seconds(30 + i % 60));
+    }
+
+    Report("timers", "priority", threads_, "add_ns",
+           Seconds(start) * 1e9 / timers, "ns");
+
+    start = steady_clock::now();
+
+    for (TimerHandle handle : handles) pool.CancelTimer(handle);
+
+    Report("timers", "priority", threads_, "cancel_ns",
+           Seconds(start) * 1e9 / timers, "ns");
+}
+
+/**
+ * @brief Run Tasks that each allocate small objects, from the heap and from
+ * their thread's Arena.
+ */
+static void BenchScratch(size_t threads_)
+{
+    const size_t calls = 100000;
+    const size_t objects = 32;
+    ThreadPool<Task> pool(threads_);
+
+    s_counter = 0;
+    steady_clock::time_point start = steady_clock::now();
+
+    for (size_t i = 0; i < calls; ++i)
+    {
+        pool.Push(Task([objects]()
+        {
+            std::vector<uint64_t *> held(objects);
+            for (uint64_t *&object : held) object = new uint64_t(1);
+            for (uint64_t *object : held) delete object;
+
+            s_counter.fetch_add(1, std::memory_order_relaxed);
+        }));
+    }
+    WaitForCount(calls);
+
+    Report("scratch", "heap", threads_, "calls_per_second",
+           calls / Seconds(start), "1/s");
+
+    s_counter = 0;
+    start = steady_clock::now();
+
+    for (size_t i = 0; i < calls; ++i)
+    {
+        pool.Push(Task([objects]()
+        {
+            Arena &arena = *Arena::Current();
+            std::vector<uint64_t *, ArenaAllocator<uint64_t *>> held(
+                objects, nullptr, ArenaAllocator<uint64_t *>(arena)
+            );
+            for (uint64_t *&object : held) object = arena.New<uint64_t>(1);
+
+            s_counter.fetch_add(1, std::memory_order_relaxed);
+        }));
+    }
+    WaitForCount(calls);
+
+    Report("scratch", "arena", threads_, "calls_per_second",
+           calls / Seconds(start), "1/s");
+}
+
+/**
+ * @brief Push Tasks too large for the inline storage from a thread outside
+ * of the pool, so every node is allocated by the pushing thread and freed
+ * by the pool's threads.
+ */
+static void BenchLargeTask(size_t threads_)
+{
+    const size_t calls = 200000;
+    ThreadPool<Task> pool(threads_);
+    std::array<char, 2 * Task::INLINE_SIZE> large{};
+
+    s_counter = 0;
+    steady_clock::time_point start = steady_clock::now();
+
+    for (size_t i = 0; i < calls; ++i)
+    {
+        while (!pool.Push(Task([large]()
+        {
+            s_counter.fetch_add(large[0] + 1, std::memory_order_relaxed);
+        })))
+        {
+            std::this_thread::yield();
+        }
+    }
+    WaitForCount(calls);
+
+    Report("large_task", "priority", threads_, "calls_per_second",
+           calls / Seconds(start), "1/s");
+}
+
+/* -------------------------------------------------------------------------- */
+/* semaphore benchmarks                                                       */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Measure an uncontended post and wait pair.
+ */
+static void BenchSemaphoreUncontended()
+{
+    const size_t rounds = 1000000;
+    Semaphore sem(0);
+
+    steady_clock::time_point start = steady_clock::now();
+
+    for (size_t i = 0; i < rounds; ++i)
+    {
+        sem.post();
+        sem.wait();
+    }
+
+    Report("semaphore_uncontended", "semaphore", 1, "pair_ns",
+           Seconds(start) * 1e9 / rounds, "ns");
+}
+
+/**
+ * @brief Half of the threads post and half wait on the same Semaphore.
+ */
+static void BenchSemaphoreContended(size_t threads_)
+{
+    const size_t rounds = 100000;
+    const size_t pairs = std::max<size_t>(threads_ / 2, 1);
+    Semaphore sem(0);
+    std::vector<thread> threads;
+
+    steady_clock::time_point start = steady_clock::now();
+
+    for (size_t i = 0; i < pairs; ++i)
+    {
+        threads.emplace_back([&](){
+            for (size_t j = 0; j < rounds; ++j) sem.post();
+        });
+        threads.emplace_back([&](){
+            for (size_t j = 0; j < rounds; ++j) sem.wait();
+        });
+    }
+
+    for (thread &worker : threads) worker.join();
+
+    Report("semaphore_contended", "semaphore", pairs * 2, "ops_per_second",
+           pairs * rounds * 2 / Seconds(start), "1/s");
+}
+
+/* -------------------------------------------------------------------------- */
+
+int main()
+{
+    typedef ThreadPool<Count> Priority;
+    typedef ThreadPool<Count, BoundedQueue<Count, 4096>> Bounded;
+    typedef ThreadPool<Count, PriorityQueue<Count>, PoolTrace<>> Traced;
+
+    std::vector<size_t> threads;
+
+    for (size_t n = 1; n < thread::hardware_concurrency(); n *= 2)
+    {
+        threads.push_back(n);
+    }
+    threads.push_back(std::max(thread::hardware_concurrency(), 1U));
+
+    for (size_t n : threads)
+    {
+        BenchThroughput<Priority>("priority", n, Priority::PRIORITY);
+        BenchThroughput<Priority>("stealing", n, Priority::STEALING);
+        BenchThroughput<Bounded>("bounded", n, Bounded::PRIORITY);
+        BenchProducers<Priority>("priority", n, Priority::PRIORITY);
+        BenchProducers<Priority>("stealing", n, Priority::STEALING);
+    }
+
+    BenchThroughput<Traced>("traced", threads.back(), Traced::PRIORITY);
+    BenchThroughput<Priority>("priority", 4, Priority::PRIORITY);
+    BenchStatic<1>();
+    BenchStatic<4>();
+
+    BenchPushBatch(threads.back());
+    BenchGroup(threads.back());
+    BenchNested(threads.back());
+    BenchLatency(threads.back(), "priority", std::chrono::microseconds(0));
+    BenchLatency(threads.back(), "spinning", std::chrono::microseconds(50));
+    BenchPause(threads.back());
+    BenchResize(threads.back());
+    BenchTimers(threads.back());
+    BenchScratch(threads.back());
+    BenchLargeTask(threads.back());
+
+    BenchQueue<PriorityQueue<Task>>("priority");
+    BenchQueue<BandQueue<Task>>("bands");
+
+    BenchSemaphoreUncontended();
+    for (size_t n : threads) BenchSemaphoreContended(n);
+
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
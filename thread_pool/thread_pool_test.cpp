@@ -6,8 +6,23 @@
 /* include libraries                                                          */
 /* -------------------------------------------------------------------------- */
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
+#include "executor_group.hpp"
+#include "parallel.hpp"
+#include "pool_trace.hpp"
+#include "static_thread_pool.hpp"
+#include "task_graph.hpp"
 #include "thread_pool.hpp"
 
 /* -------------------------------------------------------------------------- */
@@ -26,10 +41,1203 @@ bool operator<(const Call&, const Call&)
     return true;
 }
 
+/* -------------------------------------------------------------------------- */
+
+static std::atomic<size_t> s_counter(0);
+
+class Count
+{
+public:
+    void operator()()
+    {
+        ++s_counter;
+    }
+};
+
+bool operator<(const Count&, const Count&)
+{
+    return false;
+}
+
+static void WaitForCount(size_t count_)
+{
+    while (s_counter < count_) std::this_thread::yield();
+}
+
+/**
+ * @brief Move-only Callable adding it's value to s_counter.
+ */
+class Payload
+{
+public:
+    Payload() = default;
+    explicit Payload(size_t value_): m_value(new size_t(value_)) {}
+
+    Payload(const Payload&) = delete;
+    Payload& operator=(const Payload&) = delete;
+    Payload(Payload&&) = default;
+    Payload& operator=(Payload&&) = default;
+
+    void operator()()
+    {
+        s_counter += *m_value;
+    }
+
+private:
+    std::unique_ptr<size_t> m_value;
+};
+
+bool operator<(const Payload&, const Payload&)
+{
+    return false;
+}
+
+/**
+ * @brief Reduction adding the squares of the elements, and the chunk sums.
+ */
+struct SumOfSquares
+{
+    long long operator()(long long sum_, int value_) const
+    {
+        return sum_ + value_ * value_;
+    }
+
+    long long operator()(long long lhs_, long long rhs_) const
+    {
+        return lhs_ + rhs_;
+    }
+};
+
+static std::atomic<size_t> s_steals(0);
+
+/**
+ * @brief Statistics policy counting the Callables stolen.
+ */
+struct StealCount: NoStats
+{
+    explicit StealCount(size_t slots_): NoStats(slots_) {}
+
+    void OnSteal(size_t, size_t) noexcept { ++s_steals; }
+};
+
+/* -------------------------------------------------------------------------- */
+
+static void TestStealing()
+{
+    const size_t calls = 10000;
+    s_counter = 0;
+
+    ThreadPool<Count> tp(4, ThreadPool<Count>::STEALING);
+    Count call;
+
+    size_t pushed = 0;
+    for (size_t i = 0; i < calls; ++i) pushed += tp.Push(call);
+    assert(calls == pushed);
+
+    WaitForCount(calls);
+    assert(calls == s_counter);
+
+    // Outside pushes go only to the queues of running threads, so a single
+    // thread never has to steal them.
+    s_counter = 0;
+    {
+        typedef ThreadPool<Count, PriorityQueue<Count>, StealCount> Counted;
+        Counted single(1, Counted::STEALING);
+
+        pushed = 0;
+        for (size_t i = 0; i < calls; ++i) pushed += single.Push(call);
+        assert(calls == pushed);
+
+        WaitForCount(calls);
+    }
+    assert(0 == s_steals);
+}
+
+static void TestPushBatch()
+{
+    const size_t calls = 10000;
+    s_counter = 0;
+
+    ThreadPool<Count> tp(4);
+    std::vector<Count> batch(calls);
+
+    bool is_ok = tp.PushBatch(batch);
+    assert(is_ok);
+    is_ok = tp.PushBatch(batch.begin(), batch.begin() + calls / 2);
+    assert(is_ok);
+
+    WaitForCount(calls + calls / 2);
+}
+
+static void TestSubmit()
+{
+    ThreadPool<Task> tp(4);
+
+    std::future<int> sum = tp.Submit([](int a, int b){ return a + b; }, 1, 2);
+    std::future<void> none = tp.Submit([](){ ++s_counter; });
+    std::future<int> error = tp.Submit([]() -> int { throw 1; });
+
+    // Too big for the inline storage.
+    char big[Task::INLINE_SIZE * 2] = { 7 };
+    std::future<char> heap = tp.Submit([big](){ return big[0]; });
+
+    int value = sum.get();
+    assert(3 == value);
+    char first = heap.get();
+    assert(7 == first);
+    none.get();
+
+    try
+    {
+        error.get();
+        assert(false);
+    }
+    catch (int)
+    {
+        // Exception reached the future.
+    }
+}
+
+static void TestBoundedQueue()
+{
+    const size_t calls = 10000;
+    s_counter = 0;
+
+    ThreadPool<Count, BoundedQueue<Count, 16384>> tp(4);
+    std::vector<Count> batch(calls);
+
+    size_t pushed = 0;
+    for (size_t i = 0; i < calls / 2; ++i) pushed += tp.Push(batch[i]);
+    assert(calls / 2 == pushed);
+    bool is_ok = tp.PushBatch(batch.begin() + calls / 2, batch.end());
+    assert(is_ok);
+
+    WaitForCount(calls);
+
+    BoundedQueue<Count, 2> full;
+    Count call;
+
+    size_t taken = full.Push(Count()) + full.Push(Count());
+    is_ok = full.Push(Count());
+    assert(2 == taken && !is_ok);
+
+    taken = full.Pop(call) + full.Pop(call);
+    is_ok = full.Pop(call);
+    assert(2 == taken && !is_ok);
+}
+
+static void TestBandQueue()
+{
+    const size_t calls = 1000;
+    s_counter = 0;
+
+    ThreadPool<Task, BandQueue<Task>> tp(4);
+
+    for (size_t i = 0; i < calls; ++i)
+    {
+        bool is_ok = tp.Push(Task(Count(), static_cast<int>(i % 3)));
+        assert(is_ok);
+    }
+    WaitForCount(calls);
+
+    // FIFO within a band, highest band first, out of range bands clamped.
+    BandQueue<Task, 3, 0> strict;
+    std::vector<int> order;
+
+    for (int i = 0; i < 6; ++i)
+    {
+        int priority = (i % 2) ? 2 : -1;
+        strict.Push(Task([&order, i](){ order.push_back(i); }, priority));
+    }
+    strict.Push(Task([&order](){ order.push_back(6); }, 7));
+
+    Task call;
+    while (strict.Pop(call)) call();
+    assert((std::vector<int>{1, 3, 5, 6, 0, 2, 4}) == order);
+
+    // Every second Pop ages a lower band, in turn.
+    BandQueue<Task, 3, 2> aging;
+    order.clear();
+
+    for (int i = 0; i < 4; ++i)
+    {
+        aging.Push(Task([&order, i](){ order.push_back(i); }, i % 3));
+    }
+    aging.Push(Task([&order](){ order.push_back(4); }, 2));
+    aging.Push(Task([&order](){ order.push_back(5); }, 2));
+
+    while (aging.Pop(call)) call();
+    assert((std::vector<int>{2, 1, 4, 0, 5, 3}) == order);
+}
+
+static void TestArena()
+{
+    const size_t calls = 100;
+    s_counter = 0;
+
+    Arena arena;
+
+    // Aligned, and a large allocation gets a block of it's own.
+    void *small = arena.Allocate(3, 1);
+    void *aligned = arena.Allocate(8, 64);
+    void *whole = arena.Allocate(2 * Arena::BLOCK_SIZE);
+    assert(small && 0 == reinterpret_cast<uintptr_t>(aligned) % 64);
+    assert(whole);
+
+    size_t capacity = arena.GetCapacity();
+    arena.Reset();
+    whole = arena.Allocate(2 * Arena::BLOCK_SIZE);
+    small = arena.Allocate(8);
+    assert(whole && small);
+    assert(capacity == arena.GetCapacity());
+
+    std::vector<int, ArenaAllocator<int>> numbers{ArenaAllocator<int>(arena)};
+    for (int i = 0; i < 1000; ++i) numbers.push_back(i);
+    assert(999 == numbers.back());
+
+    // Every thread has it's own, for the length of a Callable.
+    assert(!Arena::Current());
+
+    ThreadPool<Task> tp(4);
+    std::array<char, 2 * Task::INLINE_SIZE> large{};
+
+    size_t pushed = 0;
+    for (size_t i = 0; i < calls; ++i)
+    {
+        pushed += tp.Push(Task([large]()
+        {
+            Arena *scratch = Arena::Current();
+            assert(scratch && large.size() == 2 * Task::INLINE_SIZE);
+
+            int *value = scratch->New<int>(1);
+            s_counter += *value;
+        }));
+    }
+    assert(calls == pushed);
+    WaitForCount(calls);
+}
+
+static void TestErrors()
+{
+    const size_t calls = 100;
+    s_counter = 0;
+
+    ThreadPool<Task> tp(1);
+    std::atomic<size_t> errors(0);
+
+    // No handler, the exception is dropped and the thread lives on.
+    bool is_ok = tp.Push(Task([](){ throw std::runtime_error("dropped"); }));
+    assert(is_ok);
+    tp.Drain();
+
+    tp.SetErrorHandler([&errors](std::exception_ptr exception_)
+    {
+        try
+        {
+            std::rethrow_exception(exception_);
+        }
+        catch (const std::runtime_error &)
+        {
+            ++errors;
+        }
+    });
+
+    for (size_t i = 0; i < calls; ++i)
+    {
+        is_ok = tp.Push(Task([](){ throw std::runtime_error("error"); }));
+        assert(is_ok);
+        is_ok = tp.Push(Task(Count()));
+        assert(is_ok);
+    }
+    WaitForCount(calls);
+    tp.Drain();
+    assert(calls == errors);
+
+    // Submit results still get their own exception.
+    std::future<int> result = tp.Submit([]() -> int { throw 1; });
+    try
+    {
+        result.get();
+        assert(false);
+    }
+    catch (int)
+    {
+        // Exception reached the future.
+    }
+    assert(calls == errors);
+}
+
+static void TestStats()
+{
+    const size_t calls = 1000;
+    s_counter = 0;
+
+    ThreadPool<Count, PriorityQueue<Count>, PoolStats> tp(2);
+    Count call;
+
+    size_t pushed = 0;
+    for (size_t i = 0; i < calls; ++i) pushed += tp.Push(call);
+    assert(calls == pushed);
+    WaitForCount(calls);
+
+    // Completion is recorded right after the call returns.
+    while (tp.GetStats().m_completed < calls) std::this_thread::yield();
+
+    StatsSnapshot stats = tp.GetStats();
+    size_t waits = 0;
+    size_t runs = 0;
+
+    for (size_t i = 0; i < StatsSnapshot::BUCKETS; ++i)
+    {
+        waits += stats.m_wait_histogram[i];
+        runs += stats.m_run_histogram[i];
+    }
+
+    assert(calls == stats.m_pushed);
+    assert(0 == stats.m_depth);
+    assert(calls == waits && calls == runs);
+
+    bool is_ok = tp.SetNumOfThreads(1);
+    assert(is_ok);
+    assert(1 == tp.GetStats().m_transitions);
+}
+
+static void TestTrace()
+{
+    const size_t calls = 100;
+    s_counter = 0;
+
+    typedef ThreadPool<Count, PriorityQueue<Count>, PoolTrace<64>> Pool;
+    Pool tp(2, Pool::STEALING);
+    Count call;
+
+    size_t pushed = 0;
+    for (size_t i = 0; i < calls; ++i) pushed += tp.Push(call);
+    assert(calls == pushed);
+    tp.Drain();
+
+    bool is_ok = tp.Pause();
+    assert(is_ok);
+    is_ok = tp.Continue();
+    assert(is_ok);
+    is_ok = tp.SetNumOfThreads(1);
+    assert(is_ok);
+
+    // Only the last 64 events of a slot are kept.
+    std::string trace = tp.GetStats();
+    size_t tasks = 0;
+
+    for (size_t at = trace.find("\"task\""); std::string::npos != at;
+         at = trace.find("\"task\"", at + 1))
+    {
+        ++tasks;
+    }
+
+    assert(0 == trace.find("{\"displayTimeUnit\""));
+    assert(0 < tasks && 2 * 64 >= tasks);
+    assert(std::string::npos != trace.find("\"pause\""));
+    assert(std::string::npos != trace.find("\"resize\""));
+    assert(std::string::npos != trace.find("\"control\""));
+}
+
+static void TestCancel()
+{
+    const size_t calls = 100;
+    s_counter = 0;
+
+    ThreadPool<Task, PriorityQueue<Task>, PoolStats> tp(1);
+    CancelSource source;
+    Semaphore gate(0);
+
+    // Queued behind a blocked thread, half of them with the token.
+    bool is_ok = tp.Push(Task([&gate](){ gate.wait(); }));
+    assert(is_ok);
+    for (size_t i = 0; i < calls; ++i)
+    {
+        is_ok = tp.Push(Task(Count()), source.GetToken());
+        assert(is_ok);
+        is_ok = tp.Push(Task(Count()));
+        assert(is_ok);
+    }
+
+    source.Cancel();
+    is_ok = tp.Push(Task(Count()), source.GetToken());
+    assert(!is_ok);
+
+    gate.post();
+    tp.Drain();
+    assert(calls == s_counter);
+    assert(calls == tp.GetStats().m_cancelled);
+    assert(0 == tp.GetStats().m_depth);
+
+    // A running Callable polls it's token.
+    CancelSource running;
+    std::atomic<bool> is_started(false);
+
+    is_ok = tp.Push(Task([&is_started](){
+        is_started = true;
+        while (!CancelToken::Current().IsCancelled())
+        {
+            std::this_thread::yield();
+        }
+    }), running.GetToken());
+    assert(is_ok);
+
+    while (!is_started) std::this_thread::yield();
+    assert(!CancelToken::Current().IsCancelled());
+
+    running.Cancel();
+    tp.Drain();
+}
+
+static void TestOverflow()
+{
+    const size_t capacity = 10;
+    s_counter = 0;
+
+    typedef ThreadPool<Task, PriorityQueue<Task>, PoolStats> Pool;
+    Pool tp(1);
+    Semaphore gate(0);
+    std::atomic<bool> is_started(false);
+
+    bool is_ok = tp.SetCapacity(capacity, Pool::REJECT);
+    assert(is_ok);
+
+    // The blocked Callable is taken, so it takes no space.
+    is_ok = tp.Push(Task([&](){ is_started = true; gate.wait(); }));
+    assert(is_ok);
+    while (!is_started) std::this_thread::yield();
+
+    size_t pushed = 0;
+    for (size_t i = 0; i < capacity; ++i) pushed += tp.Push(Task(Count()));
+    assert(capacity == pushed);
+    is_ok = tp.TryPush(Task(Count()));
+    assert(!is_ok);
+    is_ok = tp.Push(Task(Count()));
+    assert(!is_ok);
+    assert(2 == tp.GetOverflowStats().m_rejected);
+
+    // Ran by the pushing thread.
+    std::thread::id caller = std::this_thread::get_id();
+    std::thread::id ran;
+
+    tp.SetCapacity(capacity, Pool::RUN_INLINE);
+    is_ok = tp.Push(Task([&ran](){ ran = std::this_thread::get_id(); }));
+    assert(is_ok);
+    assert(caller == ran);
+    assert(1 == tp.GetOverflowStats().m_inlined);
+
+    tp.SetCapacity(capacity, Pool::DROP_OLDEST);
+    is_ok = tp.Push(Task(Count()));
+    assert(is_ok);
+    assert(1 == tp.GetOverflowStats().m_dropped);
+
+    // Waits until the thread takes a Callable.
+    tp.SetCapacity(capacity, Pool::BLOCK);
+    std::thread producer([&tp]()
+    {
+        bool is_pushed = tp.Push(Task(Count()));
+        assert(is_pushed);
+    });
+
+    while (0 == tp.GetOverflowStats().m_blocked) std::this_thread::yield();
+    gate.post();
+    producer.join();
+
+    tp.Drain();
+    assert(capacity + 1 == s_counter);
+    assert(1 == tp.GetStats().m_dropped);
+    assert(0 == tp.GetStats().m_depth);
+}
+
+static void TestExecutorGroup()
+{
+    const size_t calls = 30;
+
+    ExecutorGroup group(1);
+    std::vector<char> order;
+
+    Executor<std::function<void()>> &heavy =
+        group.AddExecutor<std::function<void()>>(2);
+    Executor<Task> &light = group.AddExecutor<Task>(1);
+    assert(2 == group.GetNumOfExecutors());
+
+    // Queued while paused, then taken by the weights.
+    bool is_ok = group.GetPool().Pause();
+    assert(is_ok);
+    for (size_t i = 0; i < calls; ++i)
+    {
+        heavy.Push([&order](){ order.push_back('h'); });
+        light.Push(Task([&order](){ order.push_back('l'); }));
+    }
+    assert(calls == heavy.GetSize());
+
+    is_ok = group.GetPool().Continue();
+    assert(is_ok);
+    group.Drain();
+
+    assert(2 * calls == order.size());
+    size_t num_heavy = std::count(order.begin(), order.begin() + calls, 'h');
+    assert(2 * calls / 3 - 1 <= num_heavy && num_heavy <= 2 * calls / 3 + 1);
+    assert(0 == light.GetSize());
+}
+
+/**
+ * @brief Split into two halves with Spawn until depth_ is 0, then count.
+ */
+static void Split(size_t depth_)
+{
+    if (0 == depth_)
+    {
+        ++s_counter;
+        return;
+    }
+
+    ThreadPool<Task> *pool = ThreadPool<Task>::Current();
+    assert(pool);
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        bool is_ok = pool->Spawn(Task([depth_](){ Split(depth_ - 1); }));
+        assert(is_ok);
+    }
+}
+
+static void TestSpawn()
+{
+    const size_t depth = 10;
+
+    assert(!ThreadPool<Task>::Current());
+
+    for (ThreadPool<Task>::Scheduling scheduling :
+         { ThreadPool<Task>::PRIORITY, ThreadPool<Task>::STEALING })
+    {
+        for (size_t limit : { 0, 4 })
+        {
+            s_counter = 0;
+
+            ThreadPool<Task> tp(4, scheduling);
+            tp.SetSpawnLimit(limit);
+
+            // Outside of the Thread Pool, pushed. Drain would not wait for
+            // the halves spawned meanwhile.
+            bool is_ok = tp.Spawn(Task([depth](){ Split(depth); }));
+            assert(is_ok);
+            WaitForCount(size_t(1) << depth);
+            tp.Drain();
+            assert((size_t(1) << depth) == s_counter);
+        }
+    }
+}
+
+static void TestStaticPool()
+{
+    const size_t calls = 1000;
+    s_counter = 0;
+
+    {
+        StaticThreadPool<Count, 4, PriorityQueue<Count>, PoolStats> tp;
+        static_assert(4 == tp.GetSize(), "Fixed number of threads.");
+
+        Count call;
+        size_t pushed = 0;
+        for (size_t i = 0; i < calls; ++i) pushed += tp.Push(call);
+        assert(calls == pushed);
+
+        bool is_ok = tp.Finish();
+        assert(is_ok);
+        assert(calls == s_counter);
+        assert(calls == tp.GetStats().m_completed);
+        assert(0 == tp.GetStats().m_depth);
+        is_ok = tp.Finish();
+        assert(!is_ok);
+        is_ok = tp.Push(call);
+        assert(!is_ok);
+    }
+
+    // Exceptions go to the handler, the threads live on.
+    std::atomic<size_t> errors(0);
+    {
+        StaticThreadPool<Task, 2, BoundedQueue<Task, 64>> tp(Affinity(),
+            [&errors](std::exception_ptr){ ++errors; });
+
+        for (size_t i = 0; i < 10; ++i)
+        {
+            while (!tp.Push(Task([](){ throw std::runtime_error("x"); })))
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        bool is_ok = tp.Finish();
+        assert(is_ok);
+    }
+    assert(10 == errors);
+
+    // Batches and Submit, as on ThreadPool.
+    s_counter = 0;
+    {
+        StaticThreadPool<Task, 2> tp;
+
+        std::vector<Task> batch;
+        for (size_t i = 0; i < 10; ++i) batch.push_back(Task(Count()));
+        bool is_ok = tp.PushBatch(batch);
+        assert(is_ok);
+
+        std::future<int> sum = tp.Submit([](int a, int b){ return a + b; },
+                                         1, 2);
+        assert(3 == sum.get());
+
+        is_ok = tp.Finish();
+        assert(is_ok);
+        assert(10 == s_counter);
+
+        std::future<void> refused = tp.Submit([](){});
+        assert(!refused.valid());
+    }
+
+    // Every Push accepted while Finish runs is called.
+    s_counter = 0;
+    for (size_t round = 0; round < 100; ++round)
+    {
+        StaticThreadPool<Count, 2> tp;
+        std::atomic<size_t> accepted(0);
+
+        std::thread pusher([&]()
+        {
+            Count call;
+            while (tp.Push(call)) ++accepted;
+        });
+
+        while (0 == accepted) std::this_thread::yield();
+        bool is_ok = tp.Finish();
+        assert(is_ok);
+
+        pusher.join();
+        assert(accepted == s_counter);
+        s_counter = 0;
+    }
+}
+
+static void TestPause()
+{
+    const size_t calls = 100;
+    s_counter = 0;
+
+    ThreadPool<Count, PriorityQueue<Count>, PoolStats> tp(4);
+    Count call;
+
+    bool is_ok = tp.Pause();
+    assert(is_ok);
+    is_ok = tp.SetNumOfThreads(2);
+    assert(!is_ok);
+
+    size_t pushed = 0;
+    for (size_t i = 0; i < calls; ++i) pushed += tp.Push(call);
+    assert(calls == pushed);
+
+    // Pause returned once no thread runs, so all of them are still queued.
+    assert(0 == s_counter);
+    assert(calls == tp.GetStats().m_depth);
+    assert(0 == tp.GetStats().m_completed);
+
+    is_ok = tp.Continue();
+    assert(is_ok);
+    WaitForCount(calls);
+}
+
+static void TestAffinity()
+{
+    const size_t calls = 1000;
+    s_counter = 0;
+
+    ThreadPool<Count> tp(2, ThreadPool<Count>::STEALING, Affinity::Nodes());
+    std::vector<Count> batch(calls);
+
+    bool is_ok = tp.PushBatch(batch);
+    assert(is_ok);
+    WaitForCount(calls);
+}
+
+static void TestMoveOnly()
+{
+    s_counter = 0;
+
+    ThreadPool<Payload> tp(2);
+    ThreadPool<Payload> stealing(2, ThreadPool<Payload>::STEALING);
+    ThreadPool<Payload, BoundedQueue<Payload, 16>> bounded(2);
+
+    bool is_ok = tp.Push(Payload(1));
+    assert(is_ok);
+    is_ok = tp.Emplace(2);
+    assert(is_ok);
+    is_ok = stealing.Push(Payload(3));
+    assert(is_ok);
+    is_ok = stealing.Emplace(4);
+    assert(is_ok);
+    is_ok = bounded.Push(Payload(5));
+    assert(is_ok);
+    is_ok = bounded.Emplace(6);
+    assert(is_ok);
+
+    WaitForCount(21);
+}
+
+static void TestTaskGraph()
+{
+    const size_t runs = 3;
+    s_counter = 0;
+
+    ThreadPool<Task> tp(2);
+    TaskGraph graph;
+    std::atomic<size_t> middle(0);
+    bool is_ordered = true;
+
+    // Diamond: first -> (left, right) -> last, with a chain after last.
+    TaskGraph::Node first = graph.AddNode([&](){ middle = 0; ++s_counter; });
+    TaskGraph::Node left = graph.AddNode([&](){ ++middle; ++s_counter; });
+    TaskGraph::Node right = graph.AddNode([&](){ ++middle; ++s_counter; });
+    TaskGraph::Node last = graph.AddNode([&](){
+        is_ordered = is_ordered && (2 == middle);
+        ++s_counter;
+    });
+    TaskGraph::Node chain = graph.AddNode([&](){ ++s_counter; });
+
+    graph.AddEdge(first, left);
+    graph.AddEdge(first, right);
+    graph.AddEdge(left, last);
+    graph.AddEdge(right, last);
+    graph.AddEdge(last, chain);
+
+    for (size_t i = 0; i < runs; ++i)
+    {
+        bool is_ok = graph.Run(tp);
+        assert(is_ok);
+        graph.Wait();
+    }
+
+    assert(is_ordered);
+    assert(runs * graph.GetSize() == s_counter);
+
+    // A throwing node does not stop the run, Wait rethrows.
+    TaskGraph failing;
+    TaskGraph::Node thrower = failing.AddNode([](){ throw 1; });
+    failing.AddEdge(thrower, failing.AddNode(Count()));
+
+    s_counter = 0;
+    bool is_ok = failing.Run(tp);
+    assert(is_ok);
+    try
+    {
+        failing.Wait();
+        assert(false);
+    }
+    catch (int)
+    {
+        // Exception of the node.
+    }
+    assert(1 == s_counter);
+    failing.Wait();
+
+    // A node dropped by the pool's destructor skips the nodes after it, and
+    // Wait throws.
+    TaskGraph dropped;
+    TaskGraph::Node root = dropped.AddNode(Count());
+    dropped.AddEdge(root, dropped.AddNode(Count()));
+    s_counter = 0;
+    {
+        ThreadPool<Task> blocked(1);
+        Semaphore started(0);
+        Semaphore release(0);
+
+        is_ok = blocked.Push(Task([&](){ started.post(); release.wait(); }));
+        assert(is_ok);
+        started.wait();
+
+        // Queued behind the blocked thread.
+        is_ok = dropped.Run(blocked);
+        assert(is_ok);
+        blocked.FinishAsync(std::function<void()>(), false);
+        release.post();
+    }
+
+    bool is_broken = false;
+    try
+    {
+        dropped.Wait();
+    }
+    catch (const std::future_error&)
+    {
+        is_broken = true;
+    }
+    assert(is_broken);
+    assert(0 == s_counter);
+
+    // The graph is destroyed as soon as Wait returns, while the thread that
+    // ran the last node may still be in it. Checked by the sanitizers.
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        TaskGraph *single = new TaskGraph;
+        single->AddNode([](){});
+
+        is_ok = single->Run(tp);
+        assert(is_ok);
+        single->Wait();
+        delete single;
+    }
+}
+
+static void TestParallel()
+{
+    const size_t size = 100000;
+
+    ThreadPool<Task> tp(3);
+    std::vector<size_t> values(size, 0);
+
+    ParallelFor(tp, size_t(0), size, [&](size_t i_){ values[i_] = i_; });
+    for (size_t i = 0; i < size; ++i) assert(i == values[i]);
+
+    ParallelForEach(tp, values, [](size_t &value_){ ++value_; }, 64);
+    size_t sum = ParallelReduce(tp, values.begin(), values.end(), size_t(0),
+                                size_t(0), std::plus<size_t>());
+    assert(size * (size + 1) / 2 == sum);
+
+    // The initial value is counted once, whatever the number of chunks.
+    sum = ParallelReduce(tp, values.begin(), values.end(), size_t(10),
+                         size_t(0), std::plus<size_t>(), 64);
+    assert(size * (size + 1) / 2 + 10 == sum);
+
+    std::vector<size_t> doubled(size);
+    ParallelTransform(tp, values.begin(), values.end(), doubled.begin(),
+                      [](size_t value_){ return 2 * value_; });
+    assert(2 * size == doubled.back());
+
+    // Every element is reduced, the first of each chunk as well.
+    std::vector<int> small(1000);
+    for (int i = 0; i < 1000; ++i) small[i] = i + 1;
+    long long squares = ParallelReduce(tp, small.begin(), small.end(), 0LL,
+                                       0LL, SumOfSquares(), 16);
+    assert(1000LL * 1001 * 2001 / 6 == squares);
+
+    // The first exception stops the loop and reaches the caller.
+    bool is_thrown = false;
+    try
+    {
+        ParallelFor(tp, 0, 1000, [](int i_){
+            if (500 == i_) throw std::runtime_error("parallel");
+        });
+    }
+    catch (const std::runtime_error&)
+    {
+        is_thrown = true;
+    }
+    assert(is_thrown);
+}
+
+static void TestTimerWheel()
+{
+    const uint64_t dues[] = { 1, 255, 256, 257, 65535, 65536, 70000,
+                              (uint64_t(1) << 24) + 5 };
+    TimerWheel<uint64_t> wheel(0);
+    uint64_t now = 0;
+    size_t fired = 0;
+
+    for (uint64_t due : dues)
+    {
+        TimerHandle handle = wheel.Add(uint64_t(due), due);
+        assert(handle);
+    }
+
+    TimerHandle cancelled = wheel.Add(0, 100);
+    bool is_ok = wheel.Cancel(cancelled);
+    assert(is_ok);
+    is_ok = wheel.Cancel(cancelled);
+    assert(!is_ok);
+
+    TimerHandle periodic = wheel.Add(0, 300, 1000);
+
+    // Every timer fires exactly on it's due tick.
+    auto fire = [&](uint64_t &due_, bool is_periodic_)
+    {
+        assert(is_periodic_ ? (now - 300) % 1000 == 0 : due_ == now);
+        fired += !is_periodic_;
+    };
+
+    for (now = 1; now <= 80000; ++now) wheel.Advance(now, fire);
+    is_ok = wheel.Cancel(periodic);
+    assert(is_ok);
+
+    now = dues[7] - 1;
+    wheel.Advance(now, fire);
+    assert(7 == fired);
+
+    now = dues[7];
+    wheel.Advance(now, fire);
+    assert(8 == fired && 0 == wheel.Size());
+}
+
+static void TestTimers()
+{
+    s_counter = 0;
+
+    ThreadPool<Task> tp(2);
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    std::atomic<bool> is_late(false);
+
+    tp.PushAfter(Task([&](){
+        is_late = (std::chrono::steady_clock::now() - start >=
+                   std::chrono::milliseconds(20));
+        ++s_counter;
+    }), std::chrono::milliseconds(20));
+
+    TimerHandle cancelled = tp.PushAfter(Task([](){ s_counter += 100; }),
+                                         std::chrono::milliseconds(10));
+    bool is_ok = tp.CancelTimer(cancelled);
+    assert(is_ok);
+
+    std::atomic<size_t> runs(0);
+    TimerHandle periodic = tp.PushPeriodic(Task([&](){ ++runs; }),
+                                           std::chrono::milliseconds(5));
+
+    WaitForCount(1);
+    assert(is_late);
+
+    while (runs < 3) std::this_thread::yield();
+    is_ok = tp.CancelTimer(periodic);
+    assert(is_ok);
+    is_ok = tp.CancelTimer(periodic);
+    assert(!is_ok);
+
+    // Copyable Callables are copied for every run.
+    ThreadPool<Count> counts(1);
+    s_counter = 0;
+    TimerHandle copied = counts.PushPeriodic(Count(),
+                                             std::chrono::milliseconds(1));
+    WaitForCount(3);
+    is_ok = counts.CancelTimer(copied);
+    assert(is_ok);
+
+    // Timers of the same tick are pushed together, past the capacity the
+    // thread keeping time drops them.
+    ThreadPool<Count> full(1);
+    is_ok = full.SetCapacity(1);
+    assert(is_ok);
+    s_counter = 0;
+
+    std::chrono::steady_clock::time_point at =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(5);
+    for (size_t i = 0; i < 3; ++i) full.PushAt(Count(), at);
+
+    WaitForCount(1);
+    while (2 != full.GetOverflowStats().m_timer_drops)
+    {
+        std::this_thread::yield();
+    }
+    full.Drain();
+    assert(1 == s_counter);
+    assert(0 == full.GetOverflowStats().m_rejected);
+}
+
+static void TestLifecycle()
+{
+    const size_t calls = 100;
+    s_counter = 0;
+
+    ThreadPool<Task> tp(2);
+    Semaphore started(0);
+    Semaphore gate(0);
+    Semaphore done(0);
+    std::atomic<bool> is_paused(false);
+
+    // Pause waits for the running Task, without blocking the caller.
+    bool is_ok = tp.Push(Task([&](){ started.post(); gate.wait(); }));
+    assert(is_ok);
+    started.wait();
+    is_ok = tp.PauseAsync([&](){ is_paused = true; done.post(); });
+    assert(is_ok);
+    assert(!is_paused);
+
+    gate.post();
+    done.wait();
+    assert(is_paused);
+    is_ok = tp.Continue();
+    assert(is_ok);
+
+    // Drain waits for the Tasks pushed before it.
+    size_t pushed = 0;
+    for (size_t i = 0; i < calls; ++i) pushed += tp.Push(Task(Count()));
+    assert(calls == pushed);
+    tp.Drain();
+    assert(calls == s_counter);
+
+    // Finish lets the Tasks left complete.
+    pushed = 0;
+    for (size_t i = 0; i < calls; ++i) pushed += tp.Push(Task(Count()));
+    assert(calls == pushed);
+    is_ok = tp.Finish(true);
+    assert(is_ok);
+    assert(2 * calls == s_counter);
+    is_ok = tp.Push(Task(Count()));
+    assert(!is_ok);
+
+    ThreadPool<Task> other(2);
+
+    is_ok = other.Push(Task([&gate](){ gate.wait(); }));
+    assert(is_ok);
+    is_ok = other.FinishAsync([&done](){ done.post(); });
+    assert(is_ok);
+    is_ok = other.Push(Task(Count()));
+    assert(!is_ok);
+    is_ok = other.FinishAsync([](){});
+    assert(!is_ok);
+
+    gate.post();
+    done.wait();
+}
+
+static void TestResize()
+{
+    const size_t calls = 100;
+    const size_t max = std::min(4U, std::thread::hardware_concurrency());
+    s_counter = 0;
+
+    ThreadPool<Task> tp(4);
+    Semaphore gate(0);
+
+    // Removing threads does not wait for the running Task.
+    bool is_ok = tp.Push(Task([&gate](){ gate.wait(); }));
+    assert(is_ok);
+    is_ok = tp.SetNumOfThreads(1);
+    assert(is_ok);
+    assert(1 == tp.GetSize());
+
+    size_t pushed = 0;
+    for (size_t i = 0; i < calls; ++i) pushed += tp.Push(Task(Count()));
+    assert(calls == pushed);
+    gate.post();
+    tp.Drain();
+    assert(calls == s_counter);
+
+    // Parked threads are reused, and end with the Pool.
+    for (size_t i = 0; i < 10; ++i)
+    {
+        is_ok = tp.SetNumOfThreads(max);
+        assert(is_ok);
+        is_ok = tp.SetNumOfThreads(1);
+        assert(is_ok);
+    }
+    is_ok = tp.SetNumOfThreads(max);
+    assert(is_ok);
+    assert(max == tp.GetSize());
+
+    pushed = 0;
+    for (size_t i = 0; i < calls; ++i) pushed += tp.Push(Task(Count()));
+    assert(calls == pushed);
+    is_ok = tp.Finish(true);
+    assert(is_ok);
+    assert(2 * calls == s_counter);
+}
+
+static void TestIdlePolicy()
+{
+    const size_t calls = 1000;
+    s_counter = 0;
+
+    ThreadPool<Task> tp(2);
+    tp.SetIdlePolicy(std::chrono::microseconds(20),
+                     std::chrono::microseconds(20));
+
+    // One at a time, then in bursts while the threads spin.
+    for (size_t i = 0; i < calls; ++i)
+    {
+        bool is_ok = tp.Push(Task(Count()));
+        assert(is_ok);
+        WaitForCount(i + 1);
+    }
+    size_t pushed = 0;
+    for (size_t i = 0; i < calls; ++i) pushed += tp.Push(Task(Count()));
+    assert(calls == pushed);
+    WaitForCount(2 * calls);
+
+    // Parked waiting threads still take Callables pushed after spinning.
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    int value = tp.Submit([](){ return 1; }).get();
+    assert(1 == value);
+
+    tp.SetIdlePolicy(std::chrono::microseconds::zero());
+    value = tp.Submit([](){ return 2; }).get();
+    assert(2 == value);
+}
+
+static void TestAutoScale()
+{
+    const size_t calls = 20;
+    const size_t max = std::min(4U, std::thread::hardware_concurrency());
+    s_counter = 0;
+
+    ThreadPool<Task> tp(1);
+    std::vector<std::future<void>> results;
+
+    bool is_ok = tp.SetAutoScale(1, max, std::chrono::milliseconds(1),
+                                 std::chrono::milliseconds(50));
+    assert(is_ok);
+
+    // A busy thread makes the Pool grow.
+    for (size_t i = 0; i < calls; ++i)
+    {
+        results.push_back(tp.Submit([](){
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            ++s_counter;
+        }));
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    for (std::future<void> &result : results) result.get();
+
+    assert(calls == s_counter);
+    assert((1 == max || 1 < tp.GetSize()) && max >= tp.GetSize());
+
+    // Idle threads retire, down to the minimum.
+    while (1 < tp.GetSize()) std::this_thread::yield();
+    assert(1 == tp.GetSize());
+
+    tp.StopAutoScale();
+    is_ok = tp.SetNumOfThreads(max);
+    assert(is_ok);
+    assert(max == tp.GetSize());
+}
+
 int main()
 {
     ThreadPool<Call> tp;
+
+    TestStealing();
+    TestPushBatch();
+    TestSubmit();
+    TestBoundedQueue();
+    TestBandQueue();
+    TestArena();
+    TestErrors();
+    TestStats();
+    TestTrace();
+    TestCancel();
+    TestOverflow();
+    TestExecutorGroup();
+    TestSpawn();
+    TestStaticPool();
+    TestPause();
+    TestAffinity();
+    TestMoveOnly();
+    TestTaskGraph();
+    TestParallel();
+    TestTimerWheel();
+    TestTimers();
+    TestLifecycle();
+    TestResize();
+    TestIdlePolicy();
+    TestAutoScale();
+
     return 0;
 }
 
-/* -------------------------------------------------------------------------- */
\ No newline at end of file
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,343 @@
+/* -------------------------------------------------------------------------- */
+/* timer_wheel.hpp                                                            */
+/* -------------------------------------------------------------------------- */
+
+#ifndef __DP_TIMER_WHEEL_HPP__
+#define __DP_TIMER_WHEEL_HPP__
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <cstddef>              // size_t
+#include <cstdint>              // uint32_t, uint64_t
+#include <optional>             // std::optional
+#include <utility>              // std::move
+#include <vector>               // std::vector
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Handle of a timer, used to cancel it. Becomes stale once the timer
+ * is fired (unless periodic) or cancelled.
+ */
+struct TimerHandle
+{
+    static const size_t NONE = static_cast<size_t>(-1);
+
+    explicit operator bool() const noexcept { return (NONE != m_index); }
+
+    size_t      m_index = NONE;         // Timer's node, NONE if invalid.
+    uint32_t    m_generation = 0;       // Node's reuse count on creation.
+};
+
+/**
+ * @brief Hierarchical timer wheel of LEVELS wheels with SLOTS slots each.
+ * Level l slots are SLOTS^l ticks wide, so 4 levels of 256 slots cover 2^32
+ * ticks. A timer is placed in the lowest level that reaches it's due tick,
+ * and moves down a level every time the wheel enters it's slot. Timers
+ * further away wait in the last level and are placed again from there.
+ * Add and Cancel are O(1): every slot is an intrusive doubly linked list of
+ * nodes kept in a single vector, reused through a free list. Not thread safe.
+ * @tparam T Type stored for every timer.
+ */
+template<class T>
+class TimerWheel
+{
+public:
+    static const size_t LEVELS = 4;
+    static const size_t SLOT_BITS = 8;
+    static const size_t SLOTS = size_t(1) << SLOT_BITS;
+
+    /**
+     * @brief Construct an empty Timer Wheel object.
+     * @param now_ Current tick.
+     */
+    explicit TimerWheel(uint64_t now_ = 0);
+
+    // non-copyable
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    /**
+     * @brief Add a timer.
+     * @param value_ Value to store, moved in.
+     * @param due_ Tick to fire at. Past ticks fire on the next Advance.
+     * @param period_ Ticks between firings, 0 to fire once.
+     * @return TimerHandle Handle to cancel the timer with.
+     */
+    TimerHandle Add(T &&value_, uint64_t due_, uint64_t period_ = 0);
+
+    /**
+     * @brief Remove a timer before it fires.
+     * @param handle_ Handle returned by Add.
+     * @return bool False if the handle is stale.
+     */
+    bool Cancel(TimerHandle handle_);
+
+    /**
+     * @brief Move the wheel up to now_, firing every timer due until then.
+     * @param now_ Current tick.
+     * @param fire_ Called as fire_(T &value, bool is_periodic). The value of
+     * a timer firing once is removed after the call, so it may be moved out.
+     */
+    template<class Fire>
+    void Advance(uint64_t now_, Fire &&fire_);
+
+    /**
+     * @brief Remove all the timers.
+     */
+    void Clear();
+
+    /**
+     * @brief Return the number of timers in the wheel.
+     */
+    size_t Size() const;
+
+private:
+    /**
+     * @brief Timer node, linked in a slot or in the free list.
+     */
+    struct Node
+    {
+        std::optional<T>    m_value;        // Empty when free.
+        uint64_t            m_due = 0;      // Tick to fire at.
+        uint64_t            m_period = 0;   // 0 if firing once.
+        size_t              m_prev = NONE;  // Previous node in the slot.
+        size_t              m_next = NONE;  // Next node in slot or free list.
+        size_t              m_slot = NONE;  // Index in m_heads.
+        uint32_t            m_generation = 0;
+    };
+
+    static const size_t NONE = TimerHandle::NONE;
+
+    /**
+     * @brief Link node_ to the slot of it's due tick.
+     */
+    void Place(size_t node_);
+
+    /**
+     * @brief Unlink node_ from it's slot.
+     */
+    void Unlink(size_t node_);
+
+    /**
+     * @brief Unlink node_, destroy it's value and free it.
+     */
+    void Free(size_t node_);
+
+    /**
+     * @brief Place again every node of a higher level slot.
+     */
+    void Cascade(size_t slot_);
+
+    /* members -------------------------------------------------------------- */
+    std::vector<Node>   m_nodes;                // All nodes, used and free.
+    size_t              m_heads[LEVELS * SLOTS];// First node of every slot.
+    size_t              m_free;                 // First free node.
+    size_t              m_size;                 // Number of timers.
+    uint64_t            m_now;                  // Last tick advanced to.
+};
+
+/* implementation ----------------------------------------------------------- */
+
+template<class T>
+TimerWheel<T>::TimerWheel(uint64_t now_):
+    m_nodes(),
+    m_free(NONE),
+    m_size(0),
+    m_now(now_)
+{
+    for (size_t &head : m_heads) head = NONE;
+}
+
+template<class T>
+TimerHandle TimerWheel<T>::Add(T &&value_, uint64_t due_, uint64_t period_)
+{
+    size_t node = m_free;
+
+    if (NONE == node)
+    {
+        node = m_nodes.size();
+        m_nodes.emplace_back();
+    }
+    else
+    {
+        m_free = m_nodes[node].m_next;
+    }
+
+    Node &timer = m_nodes[node];
+    timer.m_value.emplace(std::move(value_));
+    timer.m_due = (due_ > m_now) ? due_ : m_now + 1;
+    timer.m_period = period_;
+
+    Place(node);
+    ++m_size;
+
+    TimerHandle ret;
+    ret.m_index = node;
+    ret.m_generation = timer.m_generation;
+
+    return ret;
+}
+
+template<class T>
+bool TimerWheel<T>::Cancel(TimerHandle handle_)
+{
+    if (handle_.m_index >= m_nodes.size()) return false;
+
+    Node &timer = m_nodes[handle_.m_index];
+    if (!timer.m_value || timer.m_generation != handle_.m_generation)
+    {
+        return false;
+    }
+
+    Free(handle_.m_index);
+
+    return true;
+}
+
+template<class T>
+template<class Fire>
+void TimerWheel<T>::Advance(uint64_t now_, Fire &&fire_)
+{
+    while (m_now < now_ && 0 < m_size)
+    {
+        ++m_now;
+
+        // Entering a new slot of a higher level, highest level first.
+        size_t level = 0;
+        while (level + 1 < LEVELS &&
+               0 == (m_now & ((uint64_t(1) << ((level + 1) * SLOT_BITS)) - 1)))
+        {
+            ++level;
+        }
+        for (; 0 < level; --level)
+        {
+            Cascade(level * SLOTS +
+                    ((m_now >> (level * SLOT_BITS)) & (SLOTS - 1)));
+        }
+
+        size_t &head = m_heads[m_now & (SLOTS - 1)];
+
+        while (NONE != head)
+        {
+            size_t node = head;
+            Node &timer = m_nodes[node];
+            Unlink(node);
+
+            if (0 == timer.m_period)
+            {
+                fire_(*timer.m_value, false);
+                Free(node);
+            }
+            else
+            {
+                fire_(*timer.m_value, true);
+
+                timer.m_due += timer.m_period;
+                if (timer.m_due <= m_now) timer.m_due = m_now + 1;
+                Place(node);
+            }
+        }
+    }
+
+    // Nothing left to fire on the way.
+    if (m_now < now_) m_now = now_;
+}
+
+template<class T>
+void TimerWheel<T>::Clear()
+{
+    for (size_t node = 0; node < m_nodes.size(); ++node)
+    {
+        if (m_nodes[node].m_value) Free(node);
+    }
+}
+
+template<class T>
+size_t TimerWheel<T>::Size() const
+{
+    return m_size;
+}
+
+template<class T>
+void TimerWheel<T>::Place(size_t node_)
+{
+    Node &timer = m_nodes[node_];
+    uint64_t delta = timer.m_due - m_now;
+    uint64_t due = timer.m_due;
+
+    // Lowest level with slots wide enough to reach the due tick.
+    size_t level = 0;
+    while (level + 1 < LEVELS &&
+           delta >= (uint64_t(1) << ((level + 1) * SLOT_BITS)))
+    {
+        ++level;
+    }
+
+    // Beyond the last level, wait in it's furthest slot.
+    if (0 != (delta >> (LEVELS * SLOT_BITS)))
+    {
+        due = m_now + ((uint64_t(1) << (LEVELS * SLOT_BITS)) - 1);
+    }
+
+    size_t slot = level * SLOTS + ((due >> (level * SLOT_BITS)) & (SLOTS - 1));
+
+    timer.m_slot = slot;
+    timer.m_prev = NONE;
+    timer.m_next = m_heads[slot];
+    if (NONE != timer.m_next) m_nodes[timer.m_next].m_prev = node_;
+    m_heads[slot] = node_;
+}
+
+template<class T>
+void TimerWheel<T>::Unlink(size_t node_)
+{
+    Node &timer = m_nodes[node_];
+
+    if (NONE != timer.m_prev)
+    {
+        m_nodes[timer.m_prev].m_next = timer.m_next;
+    }
+    else
+    {
+        m_heads[timer.m_slot] = timer.m_next;
+    }
+    if (NONE != timer.m_next) m_nodes[timer.m_next].m_prev = timer.m_prev;
+
+    timer.m_prev = NONE;
+    timer.m_next = NONE;
+    timer.m_slot = NONE;
+}
+
+template<class T>
+void TimerWheel<T>::Free(size_t node_)
+{
+    Node &timer = m_nodes[node_];
+
+    if (NONE != timer.m_slot) Unlink(node_);
+
+    timer.m_value.reset();
+    ++timer.m_generation;
+    timer.m_next = m_free;
+    m_free = node_;
+    --m_size;
+}
+
+template<class T>
+void TimerWheel<T>::Cascade(size_t slot_)
+{
+    size_t node = m_heads[slot_];
+    m_heads[slot_] = NONE;
+
+    while (NONE != node)
+    {
+        size_t next = m_nodes[node].m_next;
+        Place(node);
+        node = next;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+#endif /* __DP_TIMER_WHEEL_HPP__ */
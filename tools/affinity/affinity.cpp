@@ -0,0 +1,203 @@
+/* -------------------------------------------------------------------------- */
+/* affinity.cpp                                                               */
+/* -------------------------------------------------------------------------- */
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include "affinity.hpp"
+
+#include <algorithm>            // std::max
+#include <fstream>              // std::ifstream
+#include <sstream>              // std::istringstream
+#include <string>               // std::string, std::to_string
+#include <thread>               // std::thread
+
+#ifdef __linux__
+#include <pthread.h>            // pthread_setaffinity_np
+#include <sched.h>              // cpu_set_t, sched_getcpu
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* aliases                                                                    */
+/* -------------------------------------------------------------------------- */
+
+using std::string;
+
+/* -------------------------------------------------------------------------- */
+/* static functions                                                           */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief CPUs of every NUMA node in the system, read once.
+ */
+struct Topology
+{
+    Topology();
+
+    vector<vector<size_t>>  m_node_cpus;    // CPUs of each node.
+    vector<size_t>          m_cpu_node;     // Node of each CPU.
+};
+
+/**
+ * @brief Parse a cpulist such as "0-3,8,10-11".
+ */
+static vector<size_t> ParseCpuList(const string &list_)
+{
+    vector<size_t> ret;
+    std::istringstream stream(list_);
+    string range;
+
+    while (std::getline(stream, range, ','))
+    {
+        size_t dash = range.find('-');
+        size_t first = std::stoul(range.substr(0, dash));
+        size_t last = (string::npos == dash) ? first :
+                      std::stoul(range.substr(dash + 1));
+
+        for (size_t cpu = first; cpu <= last; ++cpu) ret.push_back(cpu);
+    }
+
+    return ret;
+}
+
+Topology::Topology()
+{
+    // Nodes are numbered from 0, stop at the first missing one.
+    while (1)
+    {
+        std::ifstream file("/sys/devices/system/node/node" +
+                           std::to_string(m_node_cpus.size()) + "/cpulist");
+        string list;
+
+        if (!file || !std::getline(file, list) || list.empty()) break;
+
+        m_node_cpus.push_back(ParseCpuList(list));
+    }
+
+    // No NUMA information, a single node with all CPUs.
+    if (m_node_cpus.empty())
+    {
+        m_node_cpus.push_back(vector<size_t>());
+
+        for (size_t cpu = 0; cpu < std::thread::hardware_concurrency(); ++cpu)
+        {
+            m_node_cpus[0].push_back(cpu);
+        }
+    }
+
+    for (size_t node = 0; node < m_node_cpus.size(); ++node)
+    {
+        for (size_t cpu : m_node_cpus[node])
+        {
+            if (m_cpu_node.size() <= cpu) m_cpu_node.resize(cpu + 1, 0);
+            m_cpu_node[cpu] = node;
+        }
+    }
+}
+
+static const Topology &GetTopology()
+{
+    static const Topology s_topology;
+    return s_topology;
+}
+
+/* -------------------------------------------------------------------------- */
+
+Affinity::Affinity():
+    m_groups(),
+    m_nodes(1)
+{
+    // Do nothing
+}
+
+Affinity Affinity::Cores(const vector<size_t> &cores_)
+{
+    const Topology &topology = GetTopology();
+    Affinity ret;
+
+    for (size_t core : cores_)
+    {
+        Group group;
+        group.m_cpus.push_back(core);
+        group.m_node = (core < topology.m_cpu_node.size()) ?
+                       topology.m_cpu_node[core] : 0;
+
+        ret.m_nodes = std::max(ret.m_nodes, group.m_node + 1);
+        ret.m_groups.push_back(group);
+    }
+
+    return ret;
+}
+
+Affinity Affinity::Nodes()
+{
+    const Topology &topology = GetTopology();
+    Affinity ret;
+
+    for (size_t node = 0; node < topology.m_node_cpus.size(); ++node)
+    {
+        if (topology.m_node_cpus[node].empty()) continue;
+
+        Group group;
+        group.m_cpus = topology.m_node_cpus[node];
+        group.m_node = node;
+
+        ret.m_nodes = std::max(ret.m_nodes, node + 1);
+        ret.m_groups.push_back(group);
+    }
+
+    return ret;
+}
+
+bool Affinity::Apply(size_t slot_) const
+{
+    if (m_groups.empty()) return true;
+
+#ifdef __linux__
+    const Group &group = m_groups[slot_ % m_groups.size()];
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    for (size_t cpu : group.m_cpus) CPU_SET(cpu, &set);
+
+    return (0 == pthread_setaffinity_np(pthread_self(), sizeof(set), &set));
+#else
+    return false;
+#endif
+}
+
+size_t Affinity::GetNode(size_t slot_) const
+{
+    if (m_groups.empty()) return 0;
+
+    return m_groups[slot_ % m_groups.size()].m_node;
+}
+
+size_t Affinity::GetNumOfNodes() const
+{
+    return m_nodes;
+}
+
+size_t Affinity::CurrentNode()
+{
+#ifdef __linux__
+    const Topology &topology = GetTopology();
+    int cpu = sched_getcpu();
+
+    if (0 <= cpu && static_cast<size_t>(cpu) < topology.m_cpu_node.size())
+    {
+        return topology.m_cpu_node[cpu];
+    }
+#endif
+
+    return 0;
+}
+
+size_t Affinity::SystemNodes()
+{
+    return GetTopology().m_node_cpus.size();
+}
+
+/* -------------------------------------------------------------------------- */
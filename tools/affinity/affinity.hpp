@@ -0,0 +1,97 @@
+/* -------------------------------------------------------------------------- */
+/* affinity.hpp                                                               */
+/* -------------------------------------------------------------------------- */
+
+#ifndef __DPTOOLS_AFFINITY_HPP__
+#define __DPTOOLS_AFFINITY_HPP__
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <cstddef>              // size_t
+#include <vector>               // std::vector
+
+/* -------------------------------------------------------------------------- */
+/* import symbols                                                             */
+/* -------------------------------------------------------------------------- */
+
+using std::vector;
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Placement of a set of threads on CPUs. Threads are identified by a
+ * slot index, and slot i is placed on group i % (number of groups), where a
+ * group is a set of CPUs on a single NUMA node.
+ */
+class Affinity
+{
+public:
+    /**
+     * @brief Construct an Affinity object with no placement. Threads may run
+     * on any CPU, and are all considered to be on node 0.
+     */
+    Affinity();
+
+    /**
+     * @brief Create an Affinity object pinning every slot to a single core.
+     * @param cores_ Cores to pin to, slot i to cores_[i % cores_.size()].
+     * @return Affinity Placement on the given cores.
+     */
+    static Affinity Cores(const vector<size_t> &cores_);
+
+    /**
+     * @brief Create an Affinity object spreading the slots over the NUMA
+     * nodes round-robin. Each slot may run on any CPU of it's node.
+     * @return Affinity Placement on all the system's nodes.
+     */
+    static Affinity Nodes();
+
+    /**
+     * @brief Place the calling thread according to it's slot.
+     * @param slot_ Slot of the calling thread.
+     * @return bool Did the action succeed. Always true with no placement.
+     */
+    bool Apply(size_t slot_) const;
+
+    /**
+     * @brief Return the node a slot is placed on.
+     * @param slot_ Slot of a thread.
+     * @return size_t Index of the node.
+     */
+    size_t GetNode(size_t slot_) const;
+
+    /**
+     * @brief Return the number of nodes this placement may use.
+     */
+    size_t GetNumOfNodes() const;
+
+    /**
+     * @brief Return the node the calling thread is currently running on.
+     * @return size_t Index of the node, 0 if unknown.
+     */
+    static size_t CurrentNode();
+
+    /**
+     * @brief Return the number of NUMA nodes in the system.
+     */
+    static size_t SystemNodes();
+
+private:
+    /**
+     * @brief Set of CPUs on a single node.
+     */
+    struct Group
+    {
+        vector<size_t>  m_cpus;         // CPUs to run on.
+        size_t          m_node;         // Node of the CPUs.
+    };
+
+    /* members -------------------------------------------------------------- */
+    vector<Group>   m_groups;           // Empty for no placement.
+    size_t          m_nodes;            // Number of nodes in the groups.
+};
+
+/* -------------------------------------------------------------------------- */
+#endif /* __DPTOOLS_AFFINITY_HPP__ */
@@ -0,0 +1,36 @@
+/* -------------------------------------------------------------------------- */
+/* affinity_test.cpp                                                          */
+/* -------------------------------------------------------------------------- */
+
+/* -------------------------------------------------------------------------- */
+/* include libraries                                                          */
+/* -------------------------------------------------------------------------- */
+
+#include <cassert>
+
+#include "affinity.hpp"
+
+/* -------------------------------------------------------------------------- */
+
+int main()
+{
+    Affinity none;
+    bool is_ok = none.Apply(0);
+    assert(is_ok);
+    assert(0 == none.GetNode(5));
+    assert(1 == none.GetNumOfNodes());
+
+    Affinity core = Affinity::Cores(vector<size_t>(1, 0));
+    is_ok = core.Apply(3);
+    assert(is_ok);
+
+    Affinity nodes = Affinity::Nodes();
+    assert(nodes.GetNumOfNodes() == Affinity::SystemNodes());
+    is_ok = nodes.Apply(0);
+    assert(is_ok);
+    assert(Affinity::CurrentNode() < Affinity::SystemNodes());
+
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
@@ -8,62 +8,285 @@
 
 #include "semaphore.hpp"
 
+#ifdef __linux__
+#include <climits>              // INT_MAX
+#include <ctime>                // timespec
+#include <linux/futex.h>        // FUTEX_WAIT_PRIVATE, FUTEX_WAKE_PRIVATE
+#include <sys/syscall.h>        // SYS_futex
+#include <unistd.h>             // syscall
+#else
+#include <condition_variable>   // std::condition_variable
+#include <cstdint>              // uintptr_t
+#include <mutex>                // std::mutex, std::unique_lock
+#endif
+
 /* -------------------------------------------------------------------------- */
 /* aliases                                                                    */
 /* -------------------------------------------------------------------------- */
 
+using std::chrono::duration_cast;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+#ifndef __linux__
 using std::unique_lock;
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* static functions                                                           */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Return the number of parked threads in state_.
+ */
+static inline size_t Waiters(uint64_t state_) noexcept
+{
+    return static_cast<size_t>((state_ >> 32) & 0xffff);
+}
+
+/**
+ * @brief Return the number of parked batch waiters in state_.
+ */
+static inline size_t BatchWaiters(uint64_t state_) noexcept
+{
+    return static_cast<size_t>(state_ >> 48);
+}
+
+/**
+ * @brief Hint the CPU that the thread is spinning.
+ */
+static inline void CpuRelax() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
 
 /* -------------------------------------------------------------------------- */
 
 Semaphore::Semaphore(size_t init_count_) noexcept:
-    m_count(init_count_),
-    m_lock(),
-    m_condition()
+    m_state(init_count_ & COUNT_MASK)
 {
     // Do nothing
 }
 
 void Semaphore::post(size_t n) noexcept
 {
-    // Critical section begin.
-    unique_lock<mutex> guard(m_lock); // Lock guard
+    uint64_t state = m_state.fetch_add(n);
 
-    m_count += n;
-    m_condition.notify_all();
+    // From here on the Semaphore may be destroyed by the thread taking the
+    // count, only the counter's address is used. Only enter the kernel when
+    // someone is parked.
+    size_t waiters = Waiters(state);
+    if (0 == waiters) return;
 
-} // Critical section end.
+    Wake(GetWord(), 0 < BatchWaiters(state) ? waiters : n);
+}
 
-void Semaphore::wait() noexcept
+void Semaphore::post_quiet(size_t n) noexcept
 {
-    // Critical section begin
-    unique_lock<mutex> guard(m_lock); // Lock guard
+    m_state.fetch_add(n);
+}
 
-    m_condition.wait(guard, [=](){ return IsAvailable(); });
-    --m_count;
+void Semaphore::notify() noexcept
+{
+    uint64_t state = m_state.load();
+    size_t waiters = Waiters(state);
+    if (0 == waiters || 0 == (state & COUNT_MASK)) return;
 
-} // Critical section end
+    Wake(GetWord(), 0 < BatchWaiters(state) ? waiters : 1);
+}
+
+void Semaphore::wait() noexcept
+{
+    Acquire(1, nullptr);
+}
 
 bool Semaphore::try_wait() noexcept
 {
-    return timed_wait(seconds(0));
+    return TryDecrease();
 }
 
-bool Semaphore::timed_wait(seconds timeout_) noexcept
+bool Semaphore::timed_wait(nanoseconds timeout_) noexcept
 {
-    // Critical section begin
-    unique_lock<mutex> guard(m_lock); // Lock guard
+    return try_acquire_for(timeout_);
+}
 
-    bool result = m_condition.wait_for(guard, timeout_, [=](){ return IsAvailable(); });
-    m_count -= result;
+void Semaphore::acquire(size_t n) noexcept
+{
+    Acquire(n, nullptr);
+}
 
-    return result;
+bool Semaphore::try_acquire(size_t n) noexcept
+{
+    return TryDecrease(n);
+}
 
-} // Critical section end
+bool Semaphore::Acquire(size_t n, const steady_clock::time_point *deadline_)
+                        noexcept
+{
+    if (Spin(n)) return true;
+
+    // Announced before the last check, so a post from then on wakes it. A
+    // post may not wake this thread first, so a batch waiter gets them all.
+    uint64_t parked = WAITER + ((1 < n) ? BATCH_WAITER : 0);
+    uint64_t state = m_state.fetch_add(parked) + parked;
+
+    while (1)
+    {
+        // Take the count and leave the parked threads in a single step.
+        if (n <= (state & COUNT_MASK))
+        {
+            if (m_state.compare_exchange_weak(state, state - n - parked))
+            {
+                return true;
+            }
+            continue;
+        }
+
+        nanoseconds remaining = nanoseconds::zero();
+        if (deadline_)
+        {
+            remaining = duration_cast<nanoseconds>(
+                *deadline_ - steady_clock::now()
+            );
+            if (remaining <= nanoseconds::zero())
+            {
+                m_state.fetch_sub(parked);
+                return TryDecrease(n);
+            }
+        }
+
+        Park(static_cast<uint32_t>(state & COUNT_MASK),
+             deadline_ ? &remaining : nullptr);
+        state = m_state.load();
+    }
+}
 
 bool Semaphore::IsAvailable() const noexcept
 {
-    return (m_count > 0);
+    return (0 != (m_state.load() & COUNT_MASK));
+}
+
+bool Semaphore::TryDecrease(size_t n) noexcept
+{
+    uint64_t state = m_state.load(std::memory_order_relaxed);
+
+    while (n <= (state & COUNT_MASK))
+    {
+        if (m_state.compare_exchange_weak(state, state - n)) return true;
+    }
+
+    return false;
 }
 
-/* -------------------------------------------------------------------------- */
\ No newline at end of file
+bool Semaphore::Spin(size_t n) noexcept
+{
+    for (size_t i = 0; i < SPIN_COUNT; ++i)
+    {
+        if (TryDecrease(n)) return true;
+        CpuRelax();
+    }
+
+    return false;
+}
+
+uint32_t *Semaphore::GetWord() noexcept
+{
+    static_assert(sizeof(atomic<uint64_t>) == sizeof(uint64_t),
+                  "The counter must be a half of the state word.");
+
+    // The low half of the word holds the counter.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return reinterpret_cast<uint32_t *>(&m_state) + 1;
+#else
+    return reinterpret_cast<uint32_t *>(&m_state);
+#endif
+}
+
+#ifdef __linux__
+
+void Semaphore::Park(uint32_t count_, const nanoseconds *timeout_) noexcept
+{
+    timespec relative = {0, 0};
+
+    if (timeout_)
+    {
+        relative.tv_sec = static_cast<time_t>(timeout_->count() / 1000000000);
+        relative.tv_nsec = static_cast<long>(timeout_->count() % 1000000000);
+    }
+
+    // Sleeps only if the counter was not changed by a post since.
+    syscall(SYS_futex, GetWord(), FUTEX_WAIT_PRIVATE, count_,
+            timeout_ ? &relative : nullptr, nullptr, 0);
+}
+
+void Semaphore::Wake(const void *word_, size_t n) noexcept
+{
+    // A private futex is keyed by the address alone, the kernel does not
+    // read the memory to wake, so a freed Semaphore is no fault.
+    syscall(SYS_futex, word_, FUTEX_WAKE_PRIVATE,
+            static_cast<int>(n < INT_MAX ? n : INT_MAX), nullptr, nullptr, 0);
+}
+
+#else /* __linux__ */
+
+/**
+ * @brief Lock and condition of the threads parked on a set of addresses,
+ * outside of the Semaphores, so a wake does not touch a freed one.
+ */
+struct ParkBucket
+{
+    std::mutex              m_lock;
+    std::condition_variable m_condition;
+};
+
+static ParkBucket &GetBucket(const void *word_) noexcept
+{
+    static ParkBucket s_buckets[64];
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(word_);
+
+    return s_buckets[(address >> 6) % 64];
+}
+
+void Semaphore::Park(uint32_t count_, const nanoseconds *timeout_) noexcept
+{
+    ParkBucket &bucket = GetBucket(GetWord());
+
+    // Critical section begin
+    unique_lock<std::mutex> guard(bucket.m_lock); // Lock guard
+
+    auto is_changed = [this, count_]()
+    {
+        return count_ != (m_state.load() & COUNT_MASK);
+    };
+
+    if (timeout_)
+    {
+        bucket.m_condition.wait_for(guard, *timeout_, is_changed);
+    }
+    else
+    {
+        bucket.m_condition.wait(guard, is_changed);
+    }
+
+} // Critical section end
+
+void Semaphore::Wake(const void *word_, size_t) noexcept
+{
+    ParkBucket &bucket = GetBucket(word_);
+
+    // Critical section begin
+    unique_lock<std::mutex> guard(bucket.m_lock); // Lock guard
+
+    // Other Semaphores may share the bucket, every waiter rechecks.
+    bucket.m_condition.notify_all();
+
+} // Critical section end
+
+#endif /* __linux__ */
+
+/* -------------------------------------------------------------------------- */
@@ -10,21 +10,30 @@
 /* -------------------------------------------------------------------------- */
 
 #include <atomic>               // std::atomic
-#include <chrono>               // std::seconds
-#include <mutex>                // std::mutex
-#include <condition_variable>   // std::conditional_variable
+#include <chrono>               // std::seconds, std::chrono::nanoseconds
+#include <cstddef>              // size_t
+#include <cstdint>              // uint32_t, uint64_t
 
 /* -------------------------------------------------------------------------- */
 /* import symbols                                                             */
 /* -------------------------------------------------------------------------- */
 
 using std::atomic;
-using std::mutex;
-using std::condition_variable;
 using std::chrono::seconds;
 
 /* -------------------------------------------------------------------------- */
 
+/**
+ * @brief Counting semaphore. Uncontended wait() and post() are a single
+ * atomic operation on the counter. A blocked wait() spins for a short while
+ * before parking in the kernel (futex on Linux), and post(n) wakes at most
+ * n parked threads - all of them while a thread waits for more than one.
+ * post_quiet() leaves the wake to a later notify().
+ * try_wait() and try_acquire() never block and never take a lock.
+ * The counter and the parked threads share a single atomic word, so post()
+ * does not touch the object after the count is published: the thread taking
+ * it may destroy the Semaphore at once. The counter is limited to 2^32 - 1.
+ */
 class Semaphore
 {
 public:
@@ -50,6 +59,19 @@ public:
      */
     void post(size_t n = 1) noexcept;
 
+    /**
+     * @brief Same as post(n), but without waking parked threads. For callers
+     * that know a thread is about to take the count without parking, such as
+     * a spinning thread, and that call notify() later if it is not taken.
+     * @param n Number to add to the counter. 1 by default.
+     */
+    void post_quiet(size_t n = 1) noexcept;
+
+    /**
+     * @brief Wake a single parked thread, if the counter is not 0.
+     */
+    void notify() noexcept;
+
     /**
      * @brief Decrease the counter of the Semaphore object. This action will
      * block until it is completed.
@@ -64,14 +86,55 @@ public:
     bool try_wait() noexcept;
 
     /**
-     * @brief Same as wait(), but only block for a set amount of second;
-     * @param timeout_ Maximum blocking time of this action;
+     * @brief Same as wait(), but only block for a set amount of time;
+     * @param timeout_ Maximum blocking time of this action, seconds or finer;
      * @return true Decresed Successfully.
      * @return false Didn't decrease.
      */
-    bool timed_wait(seconds timeout_) noexcept;
+    bool timed_wait(std::chrono::nanoseconds timeout_) noexcept;
+
+    /**
+     * @brief Decrease the counter by n at once. Blocks until the counter is
+     * at least n.
+     * @param n Number to take from the counter. 1 by default.
+     */
+    void acquire(size_t n = 1) noexcept;
+
+    /**
+     * @brief Same as acquire(n), but without blocking.
+     * @return bool Did the counter decrease.
+     */
+    bool try_acquire(size_t n = 1) noexcept;
+
+    /**
+     * @brief Same as acquire(n), but only block for up to timeout_.
+     * @param timeout_ Maximum blocking time, nanoseconds or coarser.
+     * @return bool Did the counter decrease.
+     */
+    template<class Rep, class Period>
+    bool try_acquire_for(const std::chrono::duration<Rep, Period> &timeout_,
+                         size_t n = 1) noexcept;
+
+    /**
+     * @brief Same as acquire(n), but only block until deadline_.
+     * @param deadline_ Time to give up at, on any clock.
+     * @return bool Did the counter decrease.
+     */
+    template<class Clock, class Duration>
+    bool try_acquire_until(
+        const std::chrono::time_point<Clock, Duration> &deadline_,
+        size_t n = 1) noexcept;
 
 private:
+    /**
+     * @brief Decrease the counter by n, blocking until deadline_.
+     * @param deadline_ Time to give up at, or nullptr to block until done.
+     * @return bool Did the counter decrease.
+     */
+    bool Acquire(size_t n,
+                 const std::chrono::steady_clock::time_point *deadline_)
+                 noexcept;
+
     /**
      * @brief Check if Semaphore is available.
      * @return true Is available
@@ -79,11 +142,72 @@ private:
      */
     bool IsAvailable() const noexcept;
 
+    /**
+     * @brief Decrease the counter by n if it is at least n, without blocking.
+     * @return bool Did the counter decrease.
+     */
+    bool TryDecrease(size_t n = 1) noexcept;
+
+    /**
+     * @brief Try to decrease the counter by n for SPIN_COUNT iterations.
+     * @return bool Did the counter decrease.
+     */
+    bool Spin(size_t n = 1) noexcept;
+
+    /**
+     * @brief Block the thread while the counter equals count_.
+     * May return spuriously.
+     * @param count_ Counter read before the last check.
+     * @param timeout_ Maximum blocking time, or nullptr for none.
+     */
+    void Park(uint32_t count_,
+              const std::chrono::nanoseconds *timeout_) noexcept;
+
+    /**
+     * @brief Wake up to n threads parked on word_. Only uses the address,
+     * which may be freed already.
+     * @param word_ Counter half of m_state.
+     * @param n Number of threads to wake.
+     */
+    static void Wake(const void *word_, size_t n) noexcept;
+
+    /**
+     * @brief Return the address of the counter half of m_state.
+     */
+    uint32_t *GetWord() noexcept;
+
+    // Layout of m_state: the counter, the parked threads, and the parked
+    // threads waiting for more than 1.
+    static const uint64_t COUNT_MASK = 0xffffffffULL;
+    static const uint64_t WAITER = uint64_t(1) << 32;
+    static const uint64_t BATCH_WAITER = uint64_t(1) << 48;
+
+    static const size_t SPIN_COUNT = 128;   // Tries before parking.
+
     /* members -------------------------------------------------------------- */
-    atomic<size_t>      m_count;        // Number of access available
-    mutex               m_lock;         // Critical section lock
-    condition_variable  m_condition;    // Access condition
+    atomic<uint64_t>    m_state;        // Counter and parked threads
 };
 
+/* implementation ----------------------------------------------------------- */
+
+template<class Rep, class Period>
+bool Semaphore::try_acquire_for(
+    const std::chrono::duration<Rep, Period> &timeout_, size_t n) noexcept
+{
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() +
+        std::chrono::ceil<std::chrono::nanoseconds>(timeout_);
+
+    return Acquire(n, &deadline);
+}
+
+template<class Clock, class Duration>
+bool Semaphore::try_acquire_until(
+    const std::chrono::time_point<Clock, Duration> &deadline_,
+    size_t n) noexcept
+{
+    return try_acquire_for(deadline_ - Clock::now(), n);
+}
+
 /* -------------------------------------------------------------------------- */
 #endif /* __DPTOOLS_SEMAPHORE_HPP__ */
@@ -1,24 +1,127 @@
 /* -------------------------------------------------------------------------- */
-/* dummy_main.cpp                                                             */
+/* semaphore_test.cpp                                                         */
 /* -------------------------------------------------------------------------- */
 
 /* -------------------------------------------------------------------------- */
 /* include libraries                                                          */
 /* -------------------------------------------------------------------------- */
 
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
 #include "semaphore.hpp"
 
 /* -------------------------------------------------------------------------- */
 
-int main()
+static void TestWaitPost()
 {
     Semaphore sem(1);
 
     sem.wait();
+    assert(!sem.try_wait());
 
+    // Blocks until the other thread posts.
+    std::thread poster([&sem](){ sem.post(); });
     sem.wait();
+    poster.join();
+
+    assert(!sem.try_wait());
+}
+
+static void TestBatch()
+{
+    Semaphore sem(2);
+
+    assert(!sem.try_acquire(3));
+    bool is_acquired = sem.try_acquire(2);
+    assert(is_acquired && !sem.try_wait());
+
+    // A batch waiter is woken by single posts, and a single waiter too.
+    std::thread batch([&sem](){ sem.acquire(3); });
+    std::thread single([&sem](){ sem.acquire(); });
+
+    for (size_t i = 0; i < 4; ++i) sem.post();
+
+    batch.join();
+    single.join();
+    assert(!sem.try_wait());
+}
+
+static void TestTimeouts()
+{
+    Semaphore sem(0);
+
+    // Sub-millisecond timeouts, on any clock.
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    assert(!sem.try_acquire_for(std::chrono::microseconds(100)));
+    assert(!sem.try_acquire_until(std::chrono::system_clock::now() +
+                                  std::chrono::microseconds(100)));
+    assert(!sem.timed_wait(std::chrono::microseconds(100)));
+    assert(std::chrono::steady_clock::now() - start <
+           std::chrono::milliseconds(100));
+
+    assert(sem.try_acquire_for(std::chrono::seconds(1), 0));
+
+    std::thread poster([&sem](){ sem.post(); });
+    bool is_acquired = sem.try_acquire_for(std::chrono::seconds(10));
+    assert(is_acquired);
+    poster.join();
+}
+
+static void TestQuiet()
+{
+    Semaphore sem(0);
+    std::atomic<bool> is_done(false);
+
+    std::thread waiter([&](){ sem.wait(); is_done = true; });
+
+    // The count is taken by the waiter once woken, or before parking.
+    sem.post_quiet();
+    sem.notify();
+    waiter.join();
+
+    assert(is_done);
+    assert(!sem.try_wait());
+
+    // Nothing to wake with the count at 0.
+    sem.notify();
+    assert(!sem.try_wait());
+}
+
+static void TestDestroyAfterPost()
+{
+    // The waiter frees the Semaphore as soon as it takes the count, while the
+    // post may still be waking it. Checked by the sanitizers.
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        Semaphore *sem = new Semaphore(0);
+
+        std::thread waiter([sem](){ sem->wait(); delete sem; });
+
+        if (0 == i % 2) std::this_thread::yield();
+        sem->post();
+
+        waiter.join();
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+int main()
+{
+    TestWaitPost();
+    TestBatch();
+    TestTimeouts();
+    TestQuiet();
+    TestDestroyAfterPost();
+
+    std::cout << "semaphore_test passed" << std::endl;
 
     return 0;
 }
 
-/* -------------------------------------------------------------------------- */
\ No newline at end of file
+/* -------------------------------------------------------------------------- */